@@ -0,0 +1,102 @@
+#include "bmp_rows.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+	template <typename T>
+	T readLittle(const uint8_t* data) {
+		T value = 0;
+		for (std::size_t i = 0; i < sizeof(T); ++i)
+			value |= static_cast<T>(static_cast<std::make_unsigned_t<T>>(data[i]) << (8 * i));
+		return value;
+	}
+
+	constexpr int64_t fileHeaderSize = 14;
+	constexpr int64_t infoHeaderSize = 40;
+	constexpr uint32_t uncompressed = 0;
+}
+
+BmpRows::BmpRows(const std::string& path) :
+	m_file(path, std::ios::in | std::ios::binary)
+{
+	uint8_t header[fileHeaderSize + infoHeaderSize] = {};
+	if (!m_file.read(reinterpret_cast<char*>(header), sizeof(header)))
+		throw std::runtime_error("Cannot read " + path);
+	if (header[0] != 'B' || header[1] != 'M')
+		throw std::runtime_error(path + " is not a BMP file");
+
+	const uint8_t* info = header + fileHeaderSize;
+	const int64_t infoSize = readLittle<uint32_t>(info);
+	const int32_t height = readLittle<int32_t>(info + 8);
+	const uint32_t compression = readLittle<uint32_t>(info + 16);
+	m_dataOffset = readLittle<uint32_t>(header + 10);
+	m_width = readLittle<int32_t>(info + 4);
+	m_height = std::abs(static_cast<int64_t>(height));
+	m_topDown = height < 0;
+	m_bitsPerPixel = readLittle<uint16_t>(info + 14);
+	m_stride = (m_bitsPerPixel * m_width + 31) / 32 * 4;
+
+	m_supported = infoSize >= infoHeaderSize && compression == uncompressed && m_width > 0 &&
+		(m_bitsPerPixel == 8 || m_bitsPerPixel == 24 || m_bitsPerPixel == 32);
+	if (!m_supported)
+		return;
+
+	// an 8-bit image maps each index to the brightest channel of its palette entry
+	if (m_bitsPerPixel == 8) {
+		const uint32_t used = readLittle<uint32_t>(info + 32);
+		const int64_t colorCount = (used && used < 256) ? used : 256;
+		std::vector<uint8_t> palette(colorCount * 4);
+		m_file.seekg(fileHeaderSize + infoSize);
+		if (!m_file.read(reinterpret_cast<char*>(palette.data()), palette.size()))
+			throw std::runtime_error("Cannot read the palette of " + path);
+		for (int64_t i = 0; i < colorCount; ++i)
+			m_palette[i] = std::max({ palette[4 * i], palette[4 * i + 1], palette[4 * i + 2] });
+	}
+
+	m_rowSlot.assign(m_height, -1);
+}
+
+bool BmpRows::supported() const {
+	return m_supported;
+}
+
+int64_t BmpRows::width() const {
+	return m_width;
+}
+
+int64_t BmpRows::height() const {
+	return m_height;
+}
+
+void BmpRows::load(int64_t first, int64_t count) {
+	first = std::clamp<int64_t>(first, 0, m_height);
+	count = std::clamp<int64_t>(count, 0, m_height - first);
+	if (!count)
+		return;
+
+	// the rows are contiguous in the file in either storage order, so they come in with one read
+	const int64_t firstStored = m_topDown ? first : m_height - first - count;
+	std::vector<uint8_t> data(count * m_stride);
+	m_file.clear();
+	m_file.seekg(m_dataOffset + firstStored * m_stride);
+	if (!m_file.read(reinterpret_cast<char*>(data.data()), data.size()))
+		throw std::runtime_error("Truncated BMP pixel data");
+
+	const int64_t bytesPerPixel = m_bitsPerPixel / 8;
+	for (int64_t y = first; y < first + count; ++y) {
+		if (m_rowSlot[y] >= 0)
+			continue;
+		m_rowSlot[y] = static_cast<int64_t>(m_intensity.size()) / m_width;
+		const uint8_t* src = data.data() + (m_topDown ? y - first : first + count - 1 - y) * m_stride;
+		for (int64_t x = 0; x < m_width; ++x, src += bytesPerPixel) {
+			m_intensity.push_back(bytesPerPixel == 1 ? m_palette[*src] : std::max({ src[0], src[1], src[2] }));
+		}
+	}
+}
+
+uint8_t BmpRows::intensity(int64_t x, int64_t y) const {
+	return m_intensity[m_rowSlot[y] * m_width + x];
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// selected pixel rows of an uncompressed BMP file (8-bit palette, 24 or 32 bits per pixel),
+// read straight from the file without decoding the rest of the image;
+// rows are counted from the top of the image, as bmp::BMP::pixel counts them
+class BmpRows {
+private:
+	std::ifstream m_file;
+	int64_t m_width = 0, m_height = 0, m_bitsPerPixel = 0, m_stride = 0, m_dataOffset = 0;
+	bool m_topDown = false, m_supported = false;
+	std::array<uint8_t, 256> m_palette{};
+	// brightest channel per pixel of the loaded rows, and the slot of every image row or -1
+	std::vector<uint8_t> m_intensity;
+	std::vector<int64_t> m_rowSlot;
+public:
+	// reads the file headers only
+	explicit BmpRows(const std::string& path);
+
+	// false for layouts this reader does not handle, which have to be decoded by bmp::BMP
+	bool supported() const;
+	int64_t width() const;
+	int64_t height() const;
+
+	// decodes rows [first, first + count) in addition to the ones already loaded
+	void load(int64_t first, int64_t count);
+	// brightest channel of a pixel in a loaded row
+	uint8_t intensity(int64_t x, int64_t y) const;
+};
\ No newline at end of file
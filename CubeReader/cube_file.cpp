@@ -0,0 +1,81 @@
+#include "cube_file.hpp"
+#include "grid_array.hpp"
+#include "../Mesh/thread_pool.hpp"
+
+#include <algorithm>
+#include <vector>
+
+template <typename T>
+void writeValue(std::string& out, const T& value) {
+	out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeVarint(std::string& out, uint64_t value) {
+	for (; value >= 0x80; value >>= 7)
+		out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+	out.push_back(static_cast<char>(value));
+}
+
+// run length encoded unless that would be larger than the codes themselves
+std::string encodeBlock(const uint8_t* codes, std::size_t count, BlockEncoding& encoding) {
+	std::string out;
+
+	for (std::size_t i = 0, j; i < count && out.size() < count; i = j) {
+		j = std::find_if(codes + i, codes + count, [code = codes[i]](uint8_t c) { return c != code; }) - codes;
+		out.push_back(static_cast<char>(codes[i]));
+		writeVarint(out, j - i);
+	}
+
+	if (out.size() < count) {
+		encoding = BlockEncoding::RunLength;
+		return out;
+	}
+
+	encoding = BlockEncoding::Raw;
+	return { reinterpret_cast<const char*>(codes), count };
+}
+
+void writeCubeFile(std::ostream& ost, const GridArray& grid, ThreadPool* pool, int64_t blockCells) {
+	const std::vector<uint8_t> codes = grid.allCubeCodes();
+	const int64_t cellCount = static_cast<int64_t>(codes.size());
+	const int64_t blockCount = (cellCount + blockCells - 1) / blockCells;
+	std::vector<std::string> blocks(blockCount);
+	std::vector<CubeBlock> index(blockCount);
+
+	const auto encode = [&](int64_t b) {
+		const int64_t first = b * blockCells;
+		const int64_t size = std::min(blockCells, cellCount - first);
+		blocks[b] = encodeBlock(codes.data() + first, size, index[b].encoding);
+	};
+
+	for (int64_t b = 0; b < blockCount; ++b) {
+		if (pool)
+			pool->submit([&encode, b]() { encode(b); });
+		else
+			encode(b);
+	}
+	if (pool)
+		pool->wait();
+
+	std::string header;
+	header.append(cubeFileMagic, sizeof(cubeFileMagic));
+	writeValue(header, cubeFileVersion);
+	for (const auto& values : { grid.cubeCount(), grid.cubeOrigin(), grid.fullCubeCount() })
+		for (int64_t value : values)
+			writeValue(header, value);
+	writeValue(header, grid.scale());
+	writeValue(header, blockCells);
+	writeValue(header, blockCount);
+
+	uint64_t offset = header.size() + blockCount * sizeof(CubeBlock);
+	for (int64_t b = 0; b < blockCount; ++b) {
+		index[b].offset = offset;
+		index[b].size = static_cast<uint32_t>(blocks[b].size());
+		offset += blocks[b].size();
+	}
+
+	ost.write(header.data(), header.size());
+	ost.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(CubeBlock));
+	for (const std::string& block : blocks)
+		ost.write(block.data(), block.size());
+}
\ No newline at end of file
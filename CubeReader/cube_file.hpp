@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "cube_format.hpp"
+
+class GridArray;
+class ThreadPool;
+
+std::string encodeBlock(const uint8_t* codes, std::size_t count, BlockEncoding& encoding);
+// writes the version 2 layout of cube_format.hpp; blocks are encoded on the pool when one is given,
+// which must not be called from one of that pool's own tasks
+void writeCubeFile(std::ostream& ost, const GridArray& grid, ThreadPool* pool = nullptr, int64_t blockCells = 1 << 16);
\ No newline at end of file
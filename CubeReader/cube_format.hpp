@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+
+// cube file layouts, shared by the writer in CubeReader and the reader in Mesh (little endian)
+//
+// version 1, the original layout without magic or version:
+//   int64 count[3]
+//   one code per cube in x, y, z order
+//
+// version 2:
+//   "CUBE", uint32 version
+//   int64 count[3], origin[3], fullCount[3], scale
+//   int64 blockCells, blockCount
+//   blockCount x CubeBlock
+//   block data, every block holding blockCells codes except possibly the last
+// origin is in cubes of the file's own level, fullCount in cubes of the finest level;
+// a coarser level is placed in the frame of the finest one (see cubeFrame in Mesh)
+// blocks are independent, so they can be decoded in any order and in parallel
+enum class BlockEncoding : uint32_t {
+	Raw,
+	// pairs of a code and its run length as an LEB128 varint
+	RunLength,
+};
+
+struct CubeBlock {
+	// from the start of the file; blocks follow each other in index order
+	uint64_t offset;
+	uint32_t size;
+	BlockEncoding encoding;
+};
+
+static_assert(sizeof(CubeBlock) == 16);
+
+constexpr char cubeFileMagic[4] = { 'C', 'U', 'B', 'E' };
+constexpr uint32_t cubeFileVersion = 2;
\ No newline at end of file
@@ -1,85 +1,105 @@
 #include "grid_array.hpp"
-#include <bmp.hpp>
 
+#include <algorithm>
 #include <array>
 #include <bitset>
 #include <cmath>
+#include <stdexcept>
 
-constexpr int64_t realDimension(int64_t imageDim, int64_t spacing) {
-	return (imageDim - 2) / (spacing - 1) + 2;
-}
+Region gridRegion(const Region& roi, int64_t spacing, const std::array<int64_t, 3>& full) {
+	const int64_t step = spacing - 1;
+	Region points;
+
+	for (int i = 0; i < 3; ++i) {
+		const int64_t lo = std::max<int64_t>(roi.min[i], 0) / step - 1;
+		const int64_t hi = ceilDiv(std::max(roi.max[i], roi.min[i] + 1) - 1, step) + 2;
+		points.min[i] = std::clamp<int64_t>(lo, 0, full[i] - 2);
+		points.max[i] = std::clamp<int64_t>(hi, points.min[i] + 2, full[i]);
+	}
 
-constexpr bool duplicated(int64_t imageDim, int64_t spacing) {
-	return (imageDim - 1) % (spacing - 1) != 0;
+	return points;
 }
 
-GridArray::GridArray(const bmp::BMP& image, int64_t sliceHeight, int64_t spacing) :
-	m_sliceHeight(sliceHeight), m_spacing(spacing), m_w(-1), m_h(-1), m_d(-1)
-{	
-	const int64_t iw = image.width(), ih = sliceHeight, id = image.height() / sliceHeight;
-	if (iw < spacing || ih < spacing || id < spacing)
+GridArray::GridArray(const uint8_t* occupancy, const std::array<int64_t, 3>& size, const std::optional<Region>& roi) :
+	m_sliceHeight(size[1]), m_spacing(2)
+{
+	if (size[0] < 2 || size[1] < 2 || size[2] < 2)
 		return;
-	finishInit(iw, ih, id);
-
-	const bool dupX = duplicated(iw, m_spacing);
-	const bool dupY = duplicated(ih, m_spacing);
-	const bool dupZ = duplicated(id, m_spacing);
-	ImageIndexer iindex{ ih, spacing - 1 };
-
-	for (int64_t z = 0; z < m_d - dupZ; ++z) {
-		for (int64_t y = 0; y < m_h - dupY; ++y) {
-			for (int64_t x = 0; x < m_w - dupX; ++x) {
-				const auto [ix, iy] = iindex.at(x, y, z);
-				m_data[m_di.at(x, y, z)] = (image.pixel(ix, iy) != bmp::colors::black);
+	m_full = size;
+	m_finestFull = m_full;
+	finishInit(roi ? gridRegion(*roi, m_spacing, m_full) : Region{ { 0, 0, 0 }, m_full });
+
+	const DataIndexer source{ size[0], size[1] };
+	for (int64_t z = 0; z < m_d; ++z) {
+		for (int64_t y = 0; y < m_h; ++y) {
+			const uint8_t* row = occupancy + source.at(m_origin[0], m_origin[1] + y, m_origin[2] + z);
+			for (int64_t x = 0; x < m_w; ++x) {
+				set(x, y, z, row[x] != 0);
 			}
 		}
 	}
-
-	handleDuplication({ dupX, dupY, dupZ });
 }
 
-void GridArray::finishInit(int64_t iw, int64_t ih, int64_t id) {
-	m_w = realDimension(iw, m_spacing);
-	m_h = realDimension(ih, m_spacing);
-	m_d = realDimension(id, m_spacing);
-	m_data.resize(m_w * m_h * m_d);
-	m_di = { m_w, m_h };
+void GridArray::finishInit(const Region& points) {
+	m_origin = points.min;
+	m_w = points.max[0] - points.min[0];
+	m_h = points.max[1] - points.min[1];
+	m_d = points.max[2] - points.min[2];
+	m_rowWords = ceilDiv(m_w, 64);
+	m_data.assign(m_rowWords * m_h * m_d, 0);
+	m_di = { m_rowWords * 64, m_h };
 }
 
 void GridArray::handleDuplication(std::array<bool, 3> dup) {
 	if (dup[0]) {
 		for (int64_t z = 0; z < m_d - dup[2]; ++z) {
 			for (int64_t y = 0; y < m_h - dup[1]; ++y) {
-				m_data[m_di.at(m_w - 1, y, z)] = m_data[m_di.at(m_w - 2, y, z)];
+				set(m_w - 1, y, z, at(m_w - 2, y, z));
 			}
 		}
 	}
 
 	if (dup[1]) {
 		for (int64_t z = 0; z < m_d - dup[2]; ++z) {
-			for (int64_t x = 0; x < m_w; ++x) {
-				m_data[m_di.at(x, m_h - 1, z)] = m_data[m_di.at(x, m_h - 2, z)];
-			}
+			const auto src = m_data.begin() + m_di.at(0, m_h - 2, z) / 64;
+			std::copy(src, src + m_rowWords, src + m_rowWords);
 		}
 	}
 
 	if (dup[2]) {
-		for (int64_t y = 0; y < m_h; ++y) {
-			for (int64_t x = 0; x < m_w; ++x) {
-				m_data[m_di.at(x, y, m_d - 1)] = m_data[m_di.at(x, y, m_d - 2)];
-			}
-		}
+		const int64_t sliceWords = m_rowWords * m_h;
+		const auto src = m_data.begin() + (m_d - 2) * sliceWords;
+		std::copy(src, src + sliceWords, src + sliceWords);
 	}
 }
 
 bool GridArray::at(int64_t x, int64_t y, int64_t z) const {
-	return m_data[m_di.at(x, y, z)];
+	const int64_t i = m_di.at(x, y, z);
+	return (m_data[i / 64] >> (i % 64)) & 1;
+}
+
+void GridArray::set(int64_t x, int64_t y, int64_t z, bool value) {
+	const int64_t i = m_di.at(x, y, z);
+	const uint64_t bit = uint64_t{ 1 } << (i % 64);
+	m_data[i / 64] = value ? (m_data[i / 64] | bit) : (m_data[i / 64] & ~bit);
+}
+
+const uint64_t* GridArray::row(int64_t y, int64_t z) const {
+	return m_data.data() + m_di.at(0, y, z) / 64;
 }
 
 std::array<int64_t, 3> GridArray::cubeCount() const {
 	return { m_w - 1, m_h - 1, m_d - 1 };
 }
 
+std::array<int64_t, 3> GridArray::cubeOrigin() const {
+	return m_origin;
+}
+
+std::array<int64_t, 3> GridArray::fullCubeCount() const {
+	return { m_finestFull[0] - 1, m_finestFull[1] - 1, m_finestFull[2] - 1 };
+}
+
 std::bitset<8> GridArray::cubeAt(int64_t x, int64_t y, int64_t z) const {
 	std::bitset<8> c;
 
@@ -108,4 +128,143 @@ std::vector<std::bitset<8>> GridArray::allCubes() const {
 	}
 
 	return cubes;
+}
+
+std::vector<uint8_t> GridArray::allCubeCodes() const {
+	const auto [cx, cy, cz] = cubeCount();
+	std::vector<uint8_t> codes(cx * cy * cz);
+
+	for (int64_t z = 0, i = 0; z < cz; ++z) {
+		for (int64_t y = 0; y < cy; ++y) {
+			for (int64_t x = 0; x < cx; ++x) {
+				codes[i++] = static_cast<uint8_t>(cubeAt(x, y, z).to_ulong());
+			}
+		}
+	}
+
+	return codes;
+}
+
+int64_t GridArray::scale() const {
+	return m_scale;
+}
+
+// gathers the even bits of a word into its low half
+constexpr uint64_t compactEven(uint64_t x) {
+	x &= 0x5555555555555555;
+	x = (x | (x >> 1)) & 0x3333333333333333;
+	x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0F;
+	x = (x | (x >> 4)) & 0x00FF00FF00FF00FF;
+	x = (x | (x >> 8)) & 0x0000FFFF0000FFFF;
+	return (x | (x >> 16)) & 0x00000000FFFFFFFF;
+}
+
+// one bit per pair of columns, set when any of the 8 samples of the block is set
+uint64_t poolAny(const std::array<uint64_t, 4>& rows) {
+	const uint64_t any = rows[0] | rows[1] | rows[2] | rows[3];
+	return compactEven(any | (any >> 1));
+}
+
+// one bit per pair of columns, set when at least 4 of the 8 samples of the block are set
+uint64_t poolMajority(const std::array<uint64_t, 4>& rows) {
+	constexpr uint64_t pairMask = 0x5555555555555555;
+	constexpr uint64_t nibbleMask = 0x3333333333333333;
+	constexpr uint64_t lowBits = 0x1111111111111111;
+	uint64_t even = 0, odd = 0;
+
+	// 2-bit counts per column pair, summed into 4-bit fields for even and odd pairs
+	for (uint64_t r : rows) {
+		const uint64_t pairs = (r & pairMask) + ((r >> 1) & pairMask);
+		even += pairs & nibbleMask;
+		odd += (pairs >> 2) & nibbleMask;
+	}
+
+	const uint64_t evenSet = ((even >> 2) | (even >> 3)) & lowBits;
+	const uint64_t oddSet = ((odd >> 2) | (odd >> 3)) & lowBits;
+	return compactEven(evenSet | (oddSet << 2));
+}
+
+// copies a row so that column pairs of the coarser level start on even bits, repeating
+// the edge points into every pooled bit outside the row, as rows and slices are clamped
+void alignRow(const uint64_t* src, int64_t width, int64_t shift, int64_t pooledWidth, std::vector<uint64_t>& dst) {
+	const int64_t srcWords = ceilDiv(width, 64);
+	for (int64_t i = 0; i < static_cast<int64_t>(dst.size()); ++i) {
+		const uint64_t carry = (shift && i > 0 && i <= srcWords) ? (src[i - 1] >> 63) : 0;
+		dst[i] = (i < srcWords ? (src[i] << shift) : 0) | carry;
+	}
+
+	const auto setBit = [&dst](int64_t i, bool value) {
+		dst[i / 64] |= uint64_t{ value } << (i % 64);
+	};
+	if (shift)
+		setBit(0, src[0] & 1);
+	const bool last = (src[(width - 1) / 64] >> ((width - 1) % 64)) & 1;
+	for (int64_t i = width + shift; i < pooledWidth; ++i)
+		setBit(i, last);
+}
+
+bool GridArray::canDownsample() const {
+	const std::array<int64_t, 3> size = { m_w, m_h, m_d };
+	for (int i = 0; i < 3; ++i) {
+		if (ceilDiv(m_origin[i] + size[i], 2) - m_origin[i] / 2 < 2)
+			return false;
+	}
+	return true;
+}
+
+GridArray GridArray::downsample(Pooling pooling) const {
+	if (!canDownsample())
+		throw std::runtime_error("Cannot downsample a grid below one cube");
+
+	const auto pool = (pooling == Pooling::Any) ? poolAny : poolMajority;
+	GridArray coarse;
+	Region points;
+
+	// coarse point i pools the global points 2i and 2i + 1
+	for (int i = 0; i < 3; ++i) {
+		const int64_t size = std::array{ m_w, m_h, m_d }[i];
+		points.min[i] = m_origin[i] / 2;
+		points.max[i] = ceilDiv(m_origin[i] + size, 2);
+		coarse.m_full[i] = ceilDiv(m_full[i], 2);
+	}
+
+	coarse.m_sliceHeight = m_sliceHeight;
+	coarse.m_spacing = m_spacing;
+	coarse.m_scale = m_scale * 2;
+	coarse.m_finestFull = m_finestFull;
+	coarse.finishInit(points);
+
+	const int64_t shift = m_origin[0] % 2;
+	const int64_t alignedWords = coarse.m_rowWords * 2;
+	std::array<std::vector<uint64_t>, 4> aligned;
+	for (auto& buffer : aligned)
+		buffer.resize(alignedWords + 1);
+
+	const auto localIndex = [](int64_t coarseIndex, int64_t origin, int64_t size) {
+		return std::clamp<int64_t>(2 * coarseIndex - origin, 0, size - 1);
+	};
+
+	for (int64_t z = 0; z < coarse.m_d; ++z) {
+		const int64_t gz = coarse.m_origin[2] + z;
+		const int64_t z0 = localIndex(gz, m_origin[2], m_d), z1 = localIndex(gz, m_origin[2] - 1, m_d);
+
+		for (int64_t y = 0; y < coarse.m_h; ++y) {
+			const int64_t gy = coarse.m_origin[1] + y;
+			const int64_t y0 = localIndex(gy, m_origin[1], m_h), y1 = localIndex(gy, m_origin[1] - 1, m_h);
+
+			alignRow(row(y0, z0), m_w, shift, 2 * coarse.m_w, aligned[0]);
+			alignRow(row(y1, z0), m_w, shift, 2 * coarse.m_w, aligned[1]);
+			alignRow(row(y0, z1), m_w, shift, 2 * coarse.m_w, aligned[2]);
+			alignRow(row(y1, z1), m_w, shift, 2 * coarse.m_w, aligned[3]);
+
+			uint64_t* dst = coarse.m_data.data() + coarse.m_di.at(0, y, z) / 64;
+			for (int64_t w = 0; w < coarse.m_rowWords; ++w) {
+				const uint64_t lo = pool({ aligned[0][2 * w], aligned[1][2 * w], aligned[2][2 * w], aligned[3][2 * w] });
+				const uint64_t hi = pool({ aligned[0][2 * w + 1], aligned[1][2 * w + 1], aligned[2][2 * w + 1], aligned[3][2 * w + 1] });
+				dst[w] = lo | (hi << 32);
+			}
+		}
+	}
+
+	return coarse;
 }
\ No newline at end of file
@@ -2,10 +2,43 @@
 #include <array>
 #include <bitset>
 #include <cstdint>
+#include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
 namespace bmp { class BMP; }
+class BmpRows;
+class IntensityVolume;
+
+// box in image voxel coordinates (column, row within slice, slice), max exclusive
+struct Region {
+	std::array<int64_t, 3> min, max;
+};
+
+constexpr int64_t realDimension(int64_t imageDim, int64_t spacing) {
+	return (imageDim - 2) / (spacing - 1) + 2;
+}
+
+constexpr bool duplicated(int64_t imageDim, int64_t spacing) {
+	return (imageDim - 1) % (spacing - 1) != 0;
+}
+
+constexpr int64_t ceilDiv(int64_t a, int64_t b) {
+	return (a + b - 1) / b;
+}
+
+// grid points covering a voxel box plus a one-voxel halo, clamped to the full grid
+Region gridRegion(const Region& roi, int64_t spacing, const std::array<int64_t, 3>& full);
+// image rows read when sampling the points of a region, as (first, count) ranges
+std::vector<std::pair<int64_t, int64_t>> sampledRows(int64_t imageWidth, int64_t imageHeight,
+	int64_t sliceHeight, int64_t spacing, const Region& roi);
+
+// how a 2x2x2 block of points is reduced to one point of a coarser level
+enum class Pooling {
+	Any,
+	Majority,
+};
 
 class GridArray {
 	struct DataIndexer {
@@ -22,17 +55,53 @@ class GridArray {
 		}
 	};
 private:
-	std::vector<bool> m_data;
+	// rows of points packed into 64-bit words, each row starting on a new word
+	std::vector<uint64_t> m_data;
 	int64_t m_w = -1, m_h = -1, m_d = -1, m_sliceHeight, m_spacing;
+	int64_t m_rowWords = 0, m_scale = 1;
+	std::array<int64_t, 3> m_origin{}, m_full{};
+	// points of the whole volume at the finest level, whose frame every level shares
+	std::array<int64_t, 3> m_finestFull{};
 	DataIndexer m_di;
+
+	GridArray() = default;
 public:
-	GridArray(const bmp::BMP& image, int64_t sliceHeight, int64_t spacing);
+	// the image and intensity constructors and fromFile are in grid_array_image.cpp,
+	// so meshing an occupancy buffer links without the BMP and cache readers
+	GridArray(const bmp::BMP& image, int64_t sliceHeight, int64_t spacing,
+		const std::optional<Region>& roi = std::nullopt);
+	// only the rows loaded into the image are sampled, so they must cover sampledRows of the region
+	GridArray(const BmpRows& image, int64_t sliceHeight, int64_t spacing,
+		const std::optional<Region>& roi = std::nullopt);
+	// one byte per point, nonzero inside, x fastest; the region is in the same points
+	GridArray(const uint8_t* occupancy, const std::array<int64_t, 3>& size,
+		const std::optional<Region>& roi = std::nullopt);
+	// points whose intensity is at least level
+	GridArray(const IntensityVolume& volume, uint8_t level);
 
 	bool at(int64_t x, int64_t y, int64_t z) const;
 	std::array<int64_t, 3> cubeCount() const;
+	std::array<int64_t, 3> cubeOrigin() const;
+	// cubes of the whole volume at the finest level, also for a coarser level
+	std::array<int64_t, 3> fullCubeCount() const;
 	std::bitset<8> cubeAt(int64_t x, int64_t y, int64_t z) const;
 	std::vector<std::bitset<8>> allCubes() const;
+	std::vector<uint8_t> allCubeCodes() const;
+
+	// decodes only the image rows that the region samples when the file layout allows it
+	static GridArray fromFile(const std::string& path, int64_t sliceHeight, int64_t spacing,
+		const std::optional<Region>& roi = std::nullopt);
+
+	int64_t scale() const;
+	// whether the next level still has at least 2 points, one cube, along every axis
+	bool canDownsample() const;
+	// throws when canDownsample is false
+	GridArray downsample(Pooling pooling) const;
 private:
-	void finishInit(int64_t iw, int64_t ih, int64_t id);
+	template <typename Sample>
+	void sampleImage(int64_t imageWidth, int64_t imageHeight, const std::optional<Region>& roi, Sample sample);
+	void set(int64_t x, int64_t y, int64_t z, bool value);
+	const uint64_t* row(int64_t y, int64_t z) const;
+	void finishInit(const Region& points);
 	void handleDuplication(std::array<bool, 3> dup);
 };
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "grid_array.hpp"
+#include "bmp_rows.hpp"
+#include "intensity_volume.hpp"
+#include <bmp.hpp>
+
+#include <algorithm>
+#include <array>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+std::vector<std::pair<int64_t, int64_t>> sampledRows(int64_t imageWidth, int64_t imageHeight,
+	int64_t sliceHeight, int64_t spacing, const Region& roi)
+{
+	const int64_t id = imageHeight / sliceHeight;
+	if (imageWidth < spacing || sliceHeight < spacing || id < spacing)
+		return {};
+	const std::array<int64_t, 3> full = { realDimension(imageWidth, spacing), realDimension(sliceHeight, spacing), realDimension(id, spacing) };
+	const Region points = gridRegion(roi, spacing, full);
+	const int64_t step = spacing - 1;
+	std::vector<std::pair<int64_t, int64_t>> rows;
+
+	// a duplicated last point is copied rather than sampled, which only ever drops rows
+	for (int64_t z = points.min[2]; z < points.max[2]; ++z) {
+		const int64_t first = (points.min[1] + z * sliceHeight) * step;
+		const int64_t last = (points.max[1] - 1 + z * sliceHeight) * step;
+		rows.emplace_back(first, last - first + 1);
+	}
+
+	return rows;
+}
+
+template <typename Sample>
+void GridArray::sampleImage(int64_t imageWidth, int64_t imageHeight, const std::optional<Region>& roi, Sample sample) {
+	const int64_t spacing = m_spacing;
+	const int64_t iw = imageWidth, ih = m_sliceHeight, id = imageHeight / m_sliceHeight;
+	if (iw < spacing || ih < spacing || id < spacing)
+		return;
+	m_full = { realDimension(iw, m_spacing), realDimension(ih, m_spacing), realDimension(id, m_spacing) };
+	m_finestFull = m_full;
+	finishInit(roi ? gridRegion(*roi, spacing, m_full) : Region{ { 0, 0, 0 }, m_full });
+
+	// the duplicated last point only needs filling when the region reaches it
+	const bool dupX = duplicated(iw, m_spacing) && m_origin[0] + m_w == m_full[0];
+	const bool dupY = duplicated(ih, m_spacing) && m_origin[1] + m_h == m_full[1];
+	const bool dupZ = duplicated(id, m_spacing) && m_origin[2] + m_d == m_full[2];
+	ImageIndexer iindex{ ih, spacing - 1 };
+
+	// only the rows and slices inside the region are ever sampled
+	for (int64_t z = 0; z < m_d - dupZ; ++z) {
+		for (int64_t y = 0; y < m_h - dupY; ++y) {
+			for (int64_t x = 0; x < m_w - dupX; ++x) {
+				const auto [ix, iy] = iindex.at(m_origin[0] + x, m_origin[1] + y, m_origin[2] + z);
+				set(x, y, z, sample(ix, iy));
+			}
+		}
+	}
+
+	handleDuplication({ dupX, dupY, dupZ });
+}
+
+GridArray::GridArray(const bmp::BMP& image, int64_t sliceHeight, int64_t spacing, const std::optional<Region>& roi) :
+	m_sliceHeight(sliceHeight), m_spacing(spacing), m_w(-1), m_h(-1), m_d(-1)
+{
+	sampleImage(image.width(), image.height(), roi, [&image](int64_t x, int64_t y) {
+		return image.pixel(x, y) != bmp::colors::black;
+	});
+}
+
+GridArray::GridArray(const BmpRows& image, int64_t sliceHeight, int64_t spacing, const std::optional<Region>& roi) :
+	m_sliceHeight(sliceHeight), m_spacing(spacing)
+{
+	sampleImage(image.width(), image.height(), roi, [&image](int64_t x, int64_t y) {
+		return image.intensity(x, y) != 0;
+	});
+}
+
+GridArray GridArray::fromFile(const std::string& path, int64_t sliceHeight, int64_t spacing, const std::optional<Region>& roi) {
+	// reading the headers also rejects a missing or non-BMP file before any decoding
+	BmpRows image{ path };
+	if (roi && image.supported()) {
+		for (const auto& [first, count] : sampledRows(image.width(), image.height(), sliceHeight, spacing, *roi))
+			image.load(first, count);
+		return { image, sliceHeight, spacing, roi };
+	}
+
+	return { bmp::BMP{ path }, sliceHeight, spacing, roi };
+}
+
+// one bit per byte of a 64-byte block, set when the byte is at least level
+uint64_t thresholdWord(const uint8_t* bytes, uint8_t level) {
+#if defined(__SSE2__) || defined(_M_X64)
+	const __m128i threshold = _mm_set1_epi8(static_cast<char>(level));
+	uint64_t word = 0;
+	for (int i = 0; i < 4; ++i) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 16 * i));
+		const __m128i atLeast = _mm_cmpeq_epi8(_mm_max_epu8(v, threshold), v);
+		word |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(atLeast))) << (16 * i);
+	}
+	return word;
+#else
+	uint64_t word = 0;
+	for (int i = 0; i < 64; ++i)
+		word |= static_cast<uint64_t>(bytes[i] >= level) << i;
+	return word;
+#endif
+}
+
+GridArray::GridArray(const IntensityVolume& volume, uint8_t level) :
+	m_sliceHeight(volume.sliceHeight()), m_spacing(volume.spacing())
+{
+	const auto size = volume.size();
+	if (size[0] < 2 || size[1] < 2 || size[2] < 2)
+		return;
+	m_full = volume.fullSize();
+	m_finestFull = m_full;
+	const auto origin = volume.origin();
+	finishInit({ origin, { origin[0] + size[0], origin[1] + size[1], origin[2] + size[2] } });
+
+	// the padding past the last point of a row must stay clear
+	const uint64_t lastMask = (m_w % 64) ? (uint64_t{ 1 } << (m_w % 64)) - 1 : ~uint64_t{ 0 };
+	uint64_t* dst = m_data.data();
+	for (int64_t z = 0; z < m_d; ++z) {
+		for (int64_t y = 0; y < m_h; ++y, dst += m_rowWords) {
+			const uint8_t* src = volume.row(y, z);
+			for (int64_t w = 0; w < m_rowWords; ++w)
+				dst[w] = thresholdWord(src + 64 * w, level);
+			dst[m_rowWords - 1] &= lastMask;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "intensity_volume.hpp"
+#include "bmp_rows.hpp"
+#include <bmp.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+struct IntensityHeader {
+	char magic[4];
+	uint32_t version;
+	int64_t size[3], origin[3], full[3], sliceHeight, spacing, sourceTime;
+	uint64_t sourceSize, sourceLength;
+};
+
+int64_t dataOffset(uint64_t sourceLength) {
+	return ceilDiv(static_cast<int64_t>(sizeof(IntensityHeader) + sourceLength), intensityDataAlignment) * intensityDataAlignment;
+}
+
+// the form a source path is recorded in, so the same image matches however it was named
+std::string sourcePath(const std::string& path) {
+	return std::filesystem::absolute(path).lexically_normal().string();
+}
+
+int64_t writeTime(const std::string& path) {
+	return std::filesystem::last_write_time(path).time_since_epoch().count();
+}
+
+}
+
+IntensityVolume::IntensityVolume(const bmp::BMP& image, int64_t sliceHeight, int64_t spacing, const std::optional<Region>& roi) :
+	m_sliceHeight(sliceHeight), m_spacing(spacing)
+{
+	sampleImage(image.width(), image.height(), roi, [&image](int64_t x, int64_t y) {
+		const bmp::Color c = image.pixel(x, y);
+		return std::max({ c.r, c.g, c.b });
+	});
+}
+
+IntensityVolume::IntensityVolume(const BmpRows& image, int64_t sliceHeight, int64_t spacing, const std::optional<Region>& roi) :
+	m_sliceHeight(sliceHeight), m_spacing(spacing)
+{
+	sampleImage(image.width(), image.height(), roi, [&image](int64_t x, int64_t y) {
+		return image.intensity(x, y);
+	});
+}
+
+template <typename Sample>
+void IntensityVolume::sampleImage(int64_t imageWidth, int64_t imageHeight, const std::optional<Region>& roi, Sample sample) {
+	const int64_t spacing = m_spacing;
+	const int64_t iw = imageWidth, ih = m_sliceHeight, id = imageHeight / m_sliceHeight;
+	if (iw < spacing || ih < spacing || id < spacing)
+		return;
+	m_full = { realDimension(iw, spacing), realDimension(ih, spacing), realDimension(id, spacing) };
+	const Region points = roi ? gridRegion(*roi, spacing, m_full) : Region{ { 0, 0, 0 }, m_full };
+	m_origin = points.min;
+	for (int i = 0; i < 3; ++i)
+		m_size[i] = points.max[i] - points.min[i];
+	m_rowStride = ceilDiv(m_size[0], 64) * 64;
+	m_owned.assign(m_rowStride * m_size[1] * m_size[2], 0);
+	m_voxels = m_owned.data();
+
+	const auto [w, h, d] = m_size;
+	const bool dupX = duplicated(iw, spacing) && m_origin[0] + w == m_full[0];
+	const bool dupY = duplicated(ih, spacing) && m_origin[1] + h == m_full[1];
+	const bool dupZ = duplicated(id, spacing) && m_origin[2] + d == m_full[2];
+	const int64_t step = spacing - 1;
+
+	for (int64_t z = 0; z < d - dupZ; ++z) {
+		for (int64_t y = 0; y < h - dupY; ++y) {
+			uint8_t* dst = m_owned.data() + (y + h * z) * m_rowStride;
+			const int64_t iy = (m_origin[1] + y + (m_origin[2] + z) * ih) * step;
+			for (int64_t x = 0; x < w - dupX; ++x)
+				dst[x] = sample((m_origin[0] + x) * step, iy);
+			if (dupX)
+				dst[w - 1] = dst[w - 2];
+		}
+		if (dupY) {
+			uint8_t* last = m_owned.data() + (h - 1 + h * z) * m_rowStride;
+			std::copy_n(last - m_rowStride, m_rowStride, last);
+		}
+	}
+
+	if (dupZ) {
+		const int64_t sliceBytes = m_rowStride * h;
+		const auto last = m_owned.begin() + (d - 1) * sliceBytes;
+		std::copy_n(last - sliceBytes, sliceBytes, last);
+	}
+}
+
+std::optional<IntensityVolume> IntensityVolume::open(const std::string& path) {
+	if (!std::filesystem::exists(path))
+		return std::nullopt;
+
+	IntensityVolume volume;
+	volume.m_file = MappedFile{ path };
+	const uint8_t* data = volume.m_file.data();
+	if (volume.m_file.size() < sizeof(IntensityHeader))
+		return std::nullopt;
+
+	IntensityHeader header;
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, intensityFileMagic, sizeof(header.magic)) != 0 || header.version != intensityFileVersion)
+		return std::nullopt;
+	if (header.sourceLength > volume.m_file.size() - sizeof(IntensityHeader))
+		return std::nullopt;
+	const int64_t offset = dataOffset(header.sourceLength);
+
+	for (int i = 0; i < 3; ++i) {
+		volume.m_size[i] = header.size[i];
+		volume.m_origin[i] = header.origin[i];
+		volume.m_full[i] = header.full[i];
+	}
+	volume.m_sliceHeight = header.sliceHeight;
+	volume.m_spacing = header.spacing;
+	volume.m_rowStride = ceilDiv(volume.m_size[0], 64) * 64;
+	volume.m_source.assign(reinterpret_cast<const char*>(data + sizeof(IntensityHeader)), header.sourceLength);
+	volume.m_sourceSize = header.sourceSize;
+	volume.m_sourceTime = header.sourceTime;
+
+	const auto expected = static_cast<std::size_t>(offset + volume.m_rowStride * volume.m_size[1] * volume.m_size[2]);
+	if (volume.m_file.size() != expected)
+		return std::nullopt;
+	volume.m_voxels = data + offset;
+
+	return volume;
+}
+
+IntensityVolume IntensityVolume::load(const std::string& cachePath, const std::string& imagePath,
+	int64_t sliceHeight, int64_t spacing, const std::optional<Region>& roi)
+{
+	namespace fs = std::filesystem;
+	const std::string source = sourcePath(imagePath);
+	const bool haveImage = fs::exists(imagePath);
+	std::optional<IntensityVolume> cached = open(cachePath);
+
+	// without the image there is nothing to compare against beyond the path it was sampled from
+	bool fresh = cached && cached->m_source == source;
+	if (fresh && haveImage)
+		fresh = cached->m_sourceSize == fs::file_size(imagePath) && cached->m_sourceTime == writeTime(imagePath);
+
+	if (fresh) {
+		const Region points = roi ? gridRegion(*roi, spacing, cached->m_full) : Region{ { 0, 0, 0 }, cached->m_full };
+		const auto size = cached->size();
+		bool same = cached->m_sliceHeight == sliceHeight && cached->m_spacing == spacing && cached->m_origin == points.min;
+		for (int i = 0; i < 3; ++i)
+			same = same && size[i] == points.max[i] - points.min[i];
+		if (same)
+			return std::move(*cached);
+	}
+	if (!haveImage)
+		throw std::runtime_error("Cannot read " + imagePath + " and " + cachePath + " was not sampled from it the same way");
+
+	// the stale cache stays mapped otherwise while it is replaced
+	cached.reset();
+	IntensityVolume volume = fromFile(imagePath, sliceHeight, spacing, roi);
+	volume.save(cachePath);
+	return volume;
+}
+
+IntensityVolume IntensityVolume::fromFile(const std::string& path, int64_t sliceHeight, int64_t spacing,
+	const std::optional<Region>& roi)
+{
+	// reading the headers also rejects a missing or non-BMP file before any decoding
+	BmpRows image{ path };
+	std::optional<IntensityVolume> volume;
+	if (roi && image.supported()) {
+		for (const auto& [first, count] : sampledRows(image.width(), image.height(), sliceHeight, spacing, *roi))
+			image.load(first, count);
+		volume.emplace(image, sliceHeight, spacing, roi);
+	}
+	else
+		volume.emplace(bmp::BMP{ path }, sliceHeight, spacing, roi);
+
+	volume->m_source = sourcePath(path);
+	volume->m_sourceSize = std::filesystem::file_size(path);
+	volume->m_sourceTime = writeTime(path);
+	return std::move(*volume);
+}
+
+void IntensityVolume::save(const std::string& path) const {
+	IntensityHeader header{};
+	std::memcpy(header.magic, intensityFileMagic, sizeof(header.magic));
+	header.version = intensityFileVersion;
+	for (int i = 0; i < 3; ++i) {
+		header.size[i] = m_size[i];
+		header.origin[i] = m_origin[i];
+		header.full[i] = m_full[i];
+	}
+	header.sliceHeight = m_sliceHeight;
+	header.spacing = m_spacing;
+	header.sourceTime = m_sourceTime;
+	header.sourceSize = m_sourceSize;
+	header.sourceLength = m_source.size();
+
+	std::vector<char> prefix(dataOffset(header.sourceLength), 0);
+	std::memcpy(prefix.data(), &header, sizeof(header));
+	std::copy(m_source.begin(), m_source.end(), prefix.begin() + sizeof(header));
+
+	// written beside the cache and renamed over it, so a process that has the old cache
+	// mapped keeps reading it and nobody ever maps a partly written one
+	const std::string temporary = path + '.' + std::to_string(std::random_device{}()) + ".tmp";
+	std::ofstream output{ temporary, std::ios::out | std::ios::binary };
+	output.write(prefix.data(), prefix.size());
+	if (m_voxels)
+		output.write(reinterpret_cast<const char*>(m_voxels), m_rowStride * m_size[1] * m_size[2]);
+	output.close();
+
+	std::error_code error;
+	if (!output.fail())
+		std::filesystem::rename(temporary, path, error);
+	if (output.fail() || error) {
+		std::filesystem::remove(temporary, error);
+		throw std::runtime_error("Cannot write " + path);
+	}
+}
+
+std::array<int64_t, 3> IntensityVolume::size() const {
+	return m_size;
+}
+
+std::array<int64_t, 3> IntensityVolume::origin() const {
+	return m_origin;
+}
+
+std::array<int64_t, 3> IntensityVolume::fullSize() const {
+	return m_full;
+}
+
+int64_t IntensityVolume::sliceHeight() const {
+	return m_sliceHeight;
+}
+
+int64_t IntensityVolume::spacing() const {
+	return m_spacing;
+}
+
+int64_t IntensityVolume::rowStride() const {
+	return m_rowStride;
+}
+
+const uint8_t* IntensityVolume::row(int64_t y, int64_t z) const {
+	return m_voxels + (y + m_size[1] * z) * m_rowStride;
+}
+
+const std::string& IntensityVolume::source() const {
+	return m_source;
+}
+
+uint64_t IntensityVolume::sourceSize() const {
+	return m_sourceSize;
+}
+
+int64_t IntensityVolume::sourceTime() const {
+	return m_sourceTime;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "grid_array.hpp"
+#include "mapped_file.hpp"
+
+namespace bmp { class BMP; }
+class BmpRows;
+
+// intensity cache file (little endian), memory mapped when reopened:
+//   "IVOL", uint32 version
+//   int64 size[3], origin[3], full[3], sliceHeight, spacing
+//   int64 sourceTime, uint64 sourceSize, sourceLength, then the sourceLength bytes of the absolute image path
+//   zero padding up to the next multiple of intensityDataAlignment
+//   size[1] * size[2] rows of rowStride bytes, the bytes past size[0] zero
+// rows are a multiple of 64 bytes so thresholding works on whole words
+constexpr char intensityFileMagic[4] = { 'I', 'V', 'O', 'L' };
+constexpr uint32_t intensityFileVersion = 2;
+constexpr int64_t intensityDataAlignment = 64;
+
+// the sampled points of an image kept as 8-bit intensities, so any threshold can be applied later
+class IntensityVolume {
+private:
+	MappedFile m_file;
+	std::vector<uint8_t> m_owned;
+	const uint8_t* m_voxels = nullptr;
+	std::array<int64_t, 3> m_size{}, m_origin{}, m_full{};
+	int64_t m_sliceHeight = 0, m_spacing = 0, m_rowStride = 0;
+	std::string m_source;
+	uint64_t m_sourceSize = 0;
+	int64_t m_sourceTime = 0;
+
+	IntensityVolume() = default;
+public:
+	// samples the same points as GridArray, an intensity being the brightest channel
+	IntensityVolume(const bmp::BMP& image, int64_t sliceHeight, int64_t spacing,
+		const std::optional<Region>& roi = std::nullopt);
+	// only the rows loaded into the image are sampled, so they must cover sampledRows of the region
+	IntensityVolume(const BmpRows& image, int64_t sliceHeight, int64_t spacing,
+		const std::optional<Region>& roi = std::nullopt);
+	// decodes only the image rows that the region samples when the file layout allows it
+	static IntensityVolume fromFile(const std::string& path, int64_t sliceHeight, int64_t spacing,
+		const std::optional<Region>& roi = std::nullopt);
+
+	// maps a cache written by save, or returns nothing when it is missing or malformed
+	static std::optional<IntensityVolume> open(const std::string& path);
+	// reuses the cache when it was sampled the same way from this image, same size and write time, else rebuilds it;
+	// a missing image can still be served from a matching cache
+	static IntensityVolume load(const std::string& cachePath, const std::string& imagePath,
+		int64_t sliceHeight, int64_t spacing, const std::optional<Region>& roi = std::nullopt);
+	// replaces the file at path in one step
+	void save(const std::string& path) const;
+
+	std::array<int64_t, 3> size() const;
+	std::array<int64_t, 3> origin() const;
+	std::array<int64_t, 3> fullSize() const;
+	int64_t sliceHeight() const;
+	int64_t spacing() const;
+	int64_t rowStride() const;
+	const uint8_t* row(int64_t y, int64_t z) const;
+	// absolute path, byte size and write time of the image sampled, empty when it was not read from a file
+	const std::string& source() const;
+	uint64_t sourceSize() const;
+	int64_t sourceTime() const;
+private:
+	template <typename Sample>
+	void sampleImage(int64_t imageWidth, int64_t imageHeight, const std::optional<Region>& roi, Sample sample);
+};
\ No newline at end of file
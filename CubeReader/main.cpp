@@ -1,34 +1,180 @@
 #include <bmp.hpp>
+#include <algorithm>
 #include <bitset>
+#include <chrono>
 #include <cmath>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "../Mesh/manifest.hpp"
+#include "../Mesh/thread_pool.hpp"
+#include "cube_file.hpp"
 #include "grid_array.hpp"
+#include "intensity_volume.hpp"
 
-template <typename T>
-const char* bytes(const T& data) {
-	return reinterpret_cast<const char*>(&data);
+// blocks are encoded on the pool when one is given
+void writeCubes(std::string_view targetName, const GridArray& grid, ThreadPool* pool = nullptr) {
+	std::ofstream output{ targetName.data(), std::ios::out | std::ios::binary };
+	writeCubeFile(output, grid, pool);
+	output.close();
+	if (output.fail())
+		throw std::runtime_error("Cannot write " + std::string{ targetName });
 }
 
-void process(std::string_view sourceName, std::string_view targetName, int cubeSize) {
+void process(std::string_view sourceName, std::string_view targetName, int cubeSize,
+	const std::optional<Region>& roi = std::nullopt, ThreadPool* pool = nullptr)
+{
 	constexpr int sliceHeight = 32;
-	std::ofstream output{ targetName.data(), std::ios::out | std::ios::binary };
+	writeCubes(targetName, GridArray::fromFile(std::string{ sourceName }, sliceHeight, cubeSize, roi), pool);
+}
 
-	GridArray grid{ sourceName, sliceHeight, cubeSize };
+// writes <targetPrefix><level>.bin for every level of a pyramid built from a single load,
+// stopping early at a level that is a single cube along some axis
+void processLevels(std::string_view sourceName, std::string_view targetPrefix, int cubeSize,
+	int levelCount, Pooling pooling, const std::optional<Region>& roi = std::nullopt, ThreadPool* pool = nullptr)
+{
+	constexpr int sliceHeight = 32;
+	GridArray grid = GridArray::fromFile(std::string{ sourceName }, sliceHeight, cubeSize, roi);
 
-	for (int64_t dimCount : grid.cubeCount())
-		output.write(bytes(dimCount), sizeof(dimCount));
-	for (const auto& cube : grid.allCubes()) {
-		const char cubeBits = static_cast<char>(cube.to_ulong());
-		output.write(&cubeBits, sizeof(cubeBits));
+	for (int level = 0; level < levelCount; ++level) {
+		if (level && !grid.canDownsample()) {
+			std::cerr << "only " << level << " levels, level " << level - 1 << " is a single cube across\n";
+			break;
+		}
+		if (level)
+			grid = grid.downsample(pooling);
+		writeCubes(std::string{ targetPrefix } + std::to_string(level) + ".bin", grid, pool);
 	}
 }
 
-int main() {
-	process("testimg.bmp", "..\\Mesh\\cubes.bin", 2);
+// writes <targetPrefix><level>.bin for every threshold level from one cached intensity volume,
+// kept beside the image unless cacheName names another file
+void processThresholds(std::string_view sourceName, std::string_view cacheName, std::string_view targetPrefix,
+	int cubeSize, const std::vector<int>& levels, const std::optional<Region>& roi = std::nullopt,
+	ThreadPool* pool = nullptr)
+{
+	constexpr int sliceHeight = 32;
+	const std::string cachePath = cacheName.empty()
+		? std::filesystem::path{ sourceName }.replace_extension(".ivol").string() : std::string{ cacheName };
+	const IntensityVolume volume = IntensityVolume::load(cachePath, std::string{ sourceName },
+		sliceHeight, cubeSize, roi);
+
+	for (int level : levels)
+		writeCubes(std::string{ targetPrefix } + std::to_string(level) + ".bin", GridArray{ volume, static_cast<uint8_t>(level) }, pool);
+}
+
+// converts every "<image> <cubes>" pair listed in the manifest, one image per pool thread at a time,
+// each encoded serially on its thread since the pool is already busy with the images;
+// returns the number of items that failed, each of which is reported without stopping the others
+std::size_t processBatch(std::string_view manifestName, int cubeSize, ThreadPool& pool,
+	const std::optional<Region>& roi = std::nullopt)
+{
+	using Clock = std::chrono::steady_clock;
+	std::ifstream manifest{ std::string{ manifestName } };
+	const std::vector<BatchItem> items = readManifest(manifest);
+	std::mutex reportMutex;
+	std::size_t failed = 0;
+	const auto start = Clock::now();
+
+	for (const BatchItem& item : items) {
+		pool.submit([&]() {
+			const auto itemStart = Clock::now();
+			std::string error;
+			try {
+				process(item.source, item.target, cubeSize, roi);
+			}
+			catch (const std::exception& e) {
+				error = e.what();
+			}
+			const std::chrono::duration<double, std::milli> ms = Clock::now() - itemStart;
+
+			std::lock_guard lock{ reportMutex };
+			if (!error.empty()) {
+				++failed;
+				std::cout << item.source << ": failed: " << error << '\n';
+				return;
+			}
+			std::cout << item.source << " -> " << item.target << ": " << ms.count() << " ms\n";
+		});
+	}
+	pool.wait();
+
+	const std::chrono::duration<double> seconds = Clock::now() - start;
+	std::cout << items.size() - failed << '/' << items.size() << " items in " << seconds.count() << " s, "
+		<< (items.size() - failed) / seconds.count() << " items/s\n";
+	return failed;
+}
+
+// optional arguments:
+//   --roi minX minY minZ maxX maxY maxZ	voxel region to mesh
+//   --lod levelCount [any|majority]		write a pyramid of levels instead of a single file
+//   --batch manifest [threads]				convert every "<image> <cubes>" pair listed in the manifest
+//   --levels level...						write cubes_t<level>.bin for each intensity threshold in 1..255
+//   --cache path							intensity cache used by --levels, the image path with .ivol by default
+int main(int argc, char* argv[]) try {
+	std::optional<Region> roi;
+	std::string_view manifest;
+	unsigned threadCount = std::thread::hardware_concurrency();
+	int levelCount = 0;
+	Pooling pooling = Pooling::Any;
+	std::vector<int> levels;
+	std::string_view cacheName;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+		if (arg == "--roi" && i + 6 < argc) {
+			roi.emplace();
+			for (int j = 0; j < 3; ++j) {
+				roi->min[j] = std::stoll(argv[i + 1 + j]);
+				roi->max[j] = std::stoll(argv[i + 4 + j]);
+			}
+			i += 6;
+		}
+		else if (arg == "--lod" && i + 1 < argc) {
+			levelCount = std::stoi(argv[++i]);
+			const std::string_view mode = (i + 1 < argc) ? argv[i + 1] : "";
+			if (mode == "any" || mode == "majority") {
+				pooling = (mode == "majority") ? Pooling::Majority : Pooling::Any;
+				++i;
+			}
+		}
+		else if (arg == "--batch" && i + 1 < argc) {
+			manifest = argv[++i];
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				threadCount = std::stoi(argv[++i]);
+		}
+		else if (arg == "--levels") {
+			while (i + 1 < argc && argv[i + 1][0] != '-')
+				levels.push_back(std::clamp(std::stoi(argv[++i]), 1, 255));
+		}
+		else if (arg == "--cache" && i + 1 < argc) {
+			cacheName = argv[++i];
+		}
+	}
+
+	ThreadPool pool{ threadCount };
+	if (!manifest.empty())
+		return processBatch(manifest, 2, pool, roi) ? 1 : 0;
+
+	if (!levels.empty())
+		processThresholds("testimg.bmp", cacheName, "../Mesh/cubes_t", 2, levels, roi, &pool);
+	else if (levelCount)
+		processLevels("testimg.bmp", "../Mesh/cubes_lod", 2, levelCount, pooling, roi, &pool);
+	else
+		process("testimg.bmp", "../Mesh/cubes.bin", 2, roi, &pool);
+	return 0;
+}
+catch (const std::exception& e) {
+	std::cerr << e.what() << '\n';
+	return 1;
 }
 
 /*
@@ -0,0 +1,93 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER size{};
+	if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size)) {
+		m_file = nullptr;
+		throw std::runtime_error("Cannot open " + path);
+	}
+	m_size = static_cast<std::size_t>(size.QuadPart);
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping)
+		m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data) {
+		release();
+		throw std::runtime_error("Cannot map " + path);
+	}
+#else
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	struct stat info{};
+	if (fd < 0 || ::fstat(fd, &info) != 0) {
+		if (fd >= 0)
+			::close(fd);
+		throw std::runtime_error("Cannot open " + path);
+	}
+	m_size = static_cast<std::size_t>(info.st_size);
+	void* data = m_size ? ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+	::close(fd);
+	if (data == MAP_FAILED)
+		throw std::runtime_error("Cannot map " + path);
+	m_data = static_cast<const uint8_t*>(data);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		release();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+#ifdef _WIN32
+		std::swap(m_file, other.m_file);
+		std::swap(m_mapping, other.m_mapping);
+#endif
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile() {
+	release();
+}
+
+const uint8_t* MappedFile::data() const {
+	return m_data;
+}
+
+std::size_t MappedFile::size() const {
+	return m_size;
+}
+
+void MappedFile::release() {
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+	m_file = m_mapping = nullptr;
+#else
+	if (m_data)
+		::munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
\ No newline at end of file
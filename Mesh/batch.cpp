@@ -0,0 +1,94 @@
+#include "batch.hpp"
+#include "binary_cube_reader.hpp"
+#include "mesh_generator.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <mutex>
+
+using Clock = std::chrono::steady_clock;
+
+struct BatchResult {
+	std::size_t cubes = 0, faces = 0;
+	double seconds = 0;
+	// empty when the item succeeded
+	std::string error;
+};
+
+BatchResult meshItem(const BatchItem& item, PlyFormat format) {
+	// each worker keeps its builder between items, so its buffers are only grown once;
+	// it is cleared up front, as an item that threw may have left its mesh behind
+	thread_local MeshBuilder mb;
+	mb.clear();
+	MeshGenerator mgen;
+	BatchResult result;
+	const auto start = Clock::now();
+
+	std::ifstream ifs{ item.source, std::ios::in | std::ios::binary };
+	if (!ifs) {
+		result.error = "cannot open " + item.source;
+		return result;
+	}
+
+	const CubeHeader header = readCubeHeader(ifs);
+	const CubeVector cv = readCubes(ifs, header);
+
+	for (auto& [cube, offset] : cv)
+		for (auto& tri : mgen.generateMesh(cube, offset, static_cast<float>(header.scale)))
+			mb.insertTriangle(tri);
+
+	result.cubes = cv.size();
+	result.faces = mb.pendingFaceCount();
+
+	std::ofstream ofs{ item.target, std::ios::out | std::ios::binary };
+	mb.writePLY(ofs, format);
+	ofs.close();
+
+	result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	if (ofs.fail())
+		result.error = "cannot write " + item.target;
+	return result;
+}
+
+std::size_t runBatch(const std::vector<BatchItem>& items, PlyFormat format, ThreadPool& pool, std::ostream& report) {
+	std::mutex reportMutex;
+	std::size_t totalCubes = 0, totalFaces = 0, failed = 0;
+	const auto start = Clock::now();
+
+	for (const BatchItem& item : items) {
+		pool.submit([&, format]() {
+			BatchResult result;
+			try {
+				result = meshItem(item, format);
+			}
+			catch (const std::exception& e) {
+				result.error = e.what();
+			}
+			std::lock_guard lock{ reportMutex };
+
+			if (!result.error.empty()) {
+				++failed;
+				report << item.source << ": failed: " << result.error << '\n';
+				return;
+			}
+
+			totalCubes += result.cubes;
+			totalFaces += result.faces;
+			report << item.source << " -> " << item.target << ": "
+				<< result.cubes << " cubes, " << result.faces << " faces, "
+				<< result.seconds * 1e3 << " ms, "
+				<< result.cubes / result.seconds * 1e-6 << " Mcubes/s\n";
+		});
+	}
+	pool.wait();
+
+	const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	report << items.size() - failed << '/' << items.size() << " items on " << pool.size() << " threads: "
+		<< totalCubes << " cubes, " << totalFaces << " faces, " << seconds << " s, "
+		<< (items.size() - failed) / seconds << " items/s, "
+		<< totalCubes / seconds * 1e-6 << " Mcubes/s\n";
+
+	return failed;
+}
\ No newline at end of file
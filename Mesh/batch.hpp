@@ -0,0 +1,13 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "manifest.hpp"
+#include "mesh_builder.hpp"
+#include "thread_pool.hpp"
+
+// meshes every item on the pool, reporting each item as it finishes and the totals at the end;
+// an item that cannot be read or written is reported and counted, the others still run;
+// returns the number of items that failed
+std::size_t runBatch(const std::vector<BatchItem>& items, PlyFormat format, ThreadPool& pool, std::ostream& report);
\ No newline at end of file
@@ -1,28 +1,231 @@
 #include "binary_cube_reader.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
 
 template <typename T>
 char* bytes(T& x) {
 	return reinterpret_cast<char*>(&x);
 }
 
-CubeVector readCubes(std::istream& ist) {
+// bytes between the current position and the end, or -1 when the stream cannot tell
+std::streamoff remainingBytes(std::istream& ist) {
+	const std::streamoff here = ist.tellg();
+	if (here < 0 || !ist.seekg(0, std::ios::end))
+		return -1;
+	const std::streamoff end = ist.tellg();
+	ist.seekg(here);
+	return end - here;
+}
+
+// number of cubes, or -1 when a count is negative or their product overflows
+int64_t checkedCubeCount(const std::array<int64_t, 3>& count) {
+	int64_t product = 1;
+	for (int64_t c : count) {
+		if (c < 0 || (c && product > std::numeric_limits<int64_t>::max() / c))
+			return -1;
+		product *= c;
+	}
+	return product;
+}
+
+CubeFrame cubeFrame(const CubeHeader& header) {
+	const double scale = static_cast<double>(header.scale), edge = 2 * scale;
+	const auto [xO, yO, zO] = header.origin;
+	// a point of level L pools 2^L = scale finest points, so it sits scale - 1 past the first
+	const double centre = scale - 1;
+
+	return {
+		{ edge * xO + centre, 2.0 * header.fullCount[1] - edge * (yO + 1) - centre, edge * zO + centre },
+		{ edge, -edge, edge },
+	};
+}
+
+CubeHeader readCubeHeader(std::istream& ist) {
+	CubeHeader header;
+	char magic[sizeof(cubeFileMagic)] = {};
+
+	ist.read(magic, sizeof(magic));
+	if (std::equal(std::begin(magic), std::end(magic), std::begin(cubeFileMagic)))
+		ist.read(bytes(header.version), sizeof(header.version));
+	else
+		ist.seekg(-static_cast<std::streamoff>(sizeof(magic)), std::ios::cur);
+
+	for (int64_t& count : header.count)
+		ist.read(bytes(count), sizeof(count));
+
+	// the original layout is nothing but the counts and the codes, so the only thing
+	// to tell it by is the codes filling the rest of the file exactly
+	if (header.version == 1) {
+		const std::streamoff remaining = remainingBytes(ist);
+		if (!ist || (remaining >= 0 && checkedCubeCount(header.count) != remaining))
+			throw std::runtime_error("Cube header does not match the file size");
+		header.origin = { 0, 0, 0 };
+		header.fullCount = header.count;
+		header.scale = 1;
+		return header;
+	}
+
+	if (header.version != cubeFileVersion)
+		throw std::runtime_error("Unsupported cube file version " + std::to_string(header.version));
+
+	int64_t blockCount = 0;
+	for (int64_t& origin : header.origin)
+		ist.read(bytes(origin), sizeof(origin));
+	for (int64_t& count : header.fullCount)
+		ist.read(bytes(count), sizeof(count));
+	ist.read(bytes(header.scale), sizeof(header.scale));
+	ist.read(bytes(header.blockCells), sizeof(header.blockCells));
+	ist.read(bytes(blockCount), sizeof(blockCount));
+	if (!ist)
+		throw std::runtime_error("Truncated cube header");
+
+	// the index is checked against the counts and the file size before anything is allocated for it
+	const int64_t cellCount = checkedCubeCount(header.count);
+	const std::streamoff indexStart = ist.tellg();
+	const std::streamoff remaining = remainingBytes(ist);
+	const auto indexSize = static_cast<std::streamoff>(sizeof(CubeBlock));
+	if (cellCount < 0 || header.scale < 1 || header.blockCells <= 0 ||
+		blockCount != cellCount / header.blockCells + (cellCount % header.blockCells != 0) ||
+		(remaining >= 0 && blockCount > remaining / indexSize))
+		throw std::runtime_error("Invalid cube block index");
+
+	header.blocks.resize(blockCount);
+	if (!ist.read(reinterpret_cast<char*>(header.blocks.data()), blockCount * sizeof(CubeBlock)))
+		throw std::runtime_error("Truncated cube block index");
+
+	// blocks lie between the index and the end of the file, in index order and without overlap
+	const uint64_t fileEnd = (indexStart >= 0 && remaining >= 0) ?
+		static_cast<uint64_t>(indexStart + remaining) : std::numeric_limits<uint64_t>::max();
+	uint64_t next = indexStart >= 0 ? static_cast<uint64_t>(indexStart + blockCount * indexSize) : 0;
+	for (const CubeBlock& block : header.blocks) {
+		if (block.offset < next || block.offset > fileEnd || block.size > fileEnd - block.offset)
+			throw std::runtime_error("Cube block outside the file");
+		next = block.offset + block.size;
+	}
+
+	return header;
+}
+
+uint64_t readVarint(const uint8_t*& data, const uint8_t* end) {
+	uint64_t value = 0;
+	for (int shift = 0; data != end; shift += 7) {
+		const uint8_t byte = *data++;
+		value |= uint64_t{ byte & 0x7Fu } << shift;
+		if (!(byte & 0x80))
+			break;
+	}
+	return value;
+}
+
+void decodeBlock(const uint8_t* data, const CubeBlock& block, uint8_t* codes, std::size_t count) {
+	const uint8_t* end = data + block.size;
+
+	switch (block.encoding) {
+	case BlockEncoding::Raw:
+		if (block.size != count)
+			throw std::runtime_error("Raw cube block of the wrong size");
+		std::memcpy(codes, data, count);
+		return;
+	case BlockEncoding::RunLength: {
+		uint8_t* out = codes, *outEnd = codes + count;
+		while (data != end && out != outEnd) {
+			const uint8_t code = *data++;
+			const uint64_t run = std::min<uint64_t>(readVarint(data, end), outEnd - out);
+			out = std::fill_n(out, run, code);
+		}
+		if (out != outEnd)
+			throw std::runtime_error("Run length cube block too short");
+		return;
+	}
+	}
+
+	throw std::runtime_error("Unknown cube block encoding");
+}
+
+std::size_t cubeCount(const CubeHeader& header) {
+	return header.count[0] * header.count[1] * header.count[2];
+}
+
+std::size_t blockCellCount(const CubeHeader& header, std::size_t block) {
+	return std::min<std::size_t>(header.blockCells, cubeCount(header) - block * header.blockCells);
+}
+
+std::vector<uint8_t> readCubeBlock(std::istream& ist, const CubeHeader& header, std::size_t block) {
+	const CubeBlock& entry = header.blocks.at(block);
+	std::vector<uint8_t> data(entry.size), codes(blockCellCount(header, block));
+
+	ist.seekg(entry.offset);
+	if (!ist.read(reinterpret_cast<char*>(data.data()), data.size()))
+		throw std::runtime_error("Truncated cube block");
+	decodeBlock(data.data(), entry, codes.data(), codes.size());
+
+	return codes;
+}
+
+std::vector<uint8_t> readCubeCodes(std::istream& ist, const CubeHeader& header, ThreadPool* pool) {
+	std::vector<uint8_t> codes(cubeCount(header));
+
+	if (header.version < 2) {
+		if (!ist.read(reinterpret_cast<char*>(codes.data()), codes.size()))
+			throw std::runtime_error("Truncated cube data");
+		return codes;
+	}
+	if (header.blocks.empty())
+		return codes;
+
+	// the blocks are stored back to back, so all of them come in with a single read
+	const uint64_t first = header.blocks.front().offset;
+	const uint64_t last = header.blocks.back().offset + header.blocks.back().size;
+	std::vector<uint8_t> data(last - first);
+	ist.seekg(first);
+	if (!ist.read(reinterpret_cast<char*>(data.data()), data.size()))
+		throw std::runtime_error("Truncated cube blocks");
+
+	const auto decode = [&](std::size_t b) {
+		const CubeBlock& block = header.blocks[b];
+		decodeBlock(data.data() + (block.offset - first), block,
+			codes.data() + b * header.blockCells, blockCellCount(header, b));
+	};
+
+	for (std::size_t b = 0; b < header.blocks.size(); ++b) {
+		if (pool)
+			pool->submit([&decode, b]() { decode(b); });
+		else
+			decode(b);
+	}
+	if (pool)
+		pool->wait();
+
+	return codes;
+}
+
+CubeVector readCubes(std::istream& ist, const CubeHeader& header, ThreadPool* pool) {
 	CubeVector cubes;
-	int64_t xM, yM, zM;
-	char cubeData = 0;
-
-	ist.read(bytes(xM), sizeof(xM));
-	ist.read(bytes(yM), sizeof(yM));
-	ist.read(bytes(zM), sizeof(zM));
-
-	cubes.reserve(xM * yM * zM);
-	for (float z = 0; z < zM; ++z) {
-		for (float y = 0; y < yM; ++y) {
-			for (float x = 0; x < xM; ++x) {
-				ist.read(&cubeData, sizeof(cubeData));
-				cubes.push_back({ cubeData, { 2 * x, 2 * (yM - y - 1), 2 * z } });
+	const auto [xM, yM, zM] = header.count;
+	const auto [base, step] = cubeFrame(header);
+	const std::vector<uint8_t> codes = readCubeCodes(ist, header, pool);
+	auto code = codes.begin();
+
+	// offsets stay in the frame of the whole volume, even for a region or a coarser level
+	cubes.reserve(codes.size());
+	for (int64_t z = 0; z < zM; ++z) {
+		const float zOffset = static_cast<float>(base[2] + step[2] * z);
+		for (int64_t y = 0; y < yM; ++y) {
+			const float yOffset = static_cast<float>(base[1] + step[1] * y);
+			for (int64_t x = 0; x < xM; ++x) {
+				cubes.push_back({ *code++, { static_cast<float>(base[0] + step[0] * x), yOffset, zOffset } });
 			}
 		}
 	}
 
 	return cubes;
 }
+
+CubeVector readCubes(std::istream& ist) {
+	return readCubes(ist, readCubeHeader(ist));
+}
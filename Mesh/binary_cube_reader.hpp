@@ -1,12 +1,41 @@
 #pragma once
 #include <array>
 #include <bitset>
+#include <cstdint>
 #include <istream>
 #include <utility>
 #include <vector>
 
+#include "../CubeReader/cube_format.hpp"
 #include "mesh_builder.hpp"
 
+class ThreadPool;
+
 using CubeVector = std::vector<std::pair<std::bitset<8>, Point>>;
 
+// version 1 files hold only the counts, so they cover the whole volume at scale 1;
+// version 2 files split the codes into independently compressed blocks
+struct CubeHeader {
+	std::array<int64_t, 3> count, origin, fullCount;
+	int64_t scale;
+	uint32_t version = 1;
+	int64_t blockCells = 0;
+	std::vector<CubeBlock> blocks;
+};
+
+// cube offsets grow linearly with the cube index along each axis, as base + step * index;
+// every level shares the frame of the finest one, a coarse cube being centred on the
+// finest points it pools, and y is flipped over the full height of the finest level
+struct CubeFrame {
+	std::array<double, 3> base, step;
+};
+
+CubeFrame cubeFrame(const CubeHeader& header);
+CubeHeader readCubeHeader(std::istream& ist);
+// codes of a single block, read from its recorded offset
+std::vector<uint8_t> readCubeBlock(std::istream& ist, const CubeHeader& header, std::size_t block);
+// codes of all cubes in x, y, z order; blocks are decoded on the pool when one is given,
+// which must not be called from one of that pool's own tasks
+std::vector<uint8_t> readCubeCodes(std::istream& ist, const CubeHeader& header, ThreadPool* pool = nullptr);
+CubeVector readCubes(std::istream& ist, const CubeHeader& header, ThreadPool* pool = nullptr);
 CubeVector readCubes(std::istream& ist);
@@ -1,27 +1,138 @@
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "batch.hpp"
 #include "binary_cube_reader.hpp"
 #include "mesh_generator.hpp"
+#include "mesh_stats.hpp"
+#include "mesh_writer.hpp"
+#include "sparse_volume.hpp"
 
-int main() {
-	MeshGenerator mgen;
+// meshing and writing overlap: the vertices go to the writer thread every chunkSize of them.
+// PLY lists every vertex before the first face, so the faces are kept until meshing is done
+// and then handed over together; the vertex index already holds that much memory anyway
+bool meshCubes(MeshGenerator& mgen, ThreadPool& pool, const CubeVector& cv, float scale,
+	const std::string& targetName, PlyFormat format)
+{
+	constexpr std::size_t chunkSize = 1 << 16;
 	MeshBuilder mb;
+	AsyncMeshWriter writer{ targetName, format, &pool };
+
+	for (auto& [cube, offset] : cv) {
+		for (auto& tri : mgen.generateMesh(cube, offset, scale))
+			mb.insertTriangle(tri);
+		if (mb.pendingVertexCount() >= chunkSize) {
+			MeshChunk chunk = writer.acquire();
+			mb.takePendingVertices(chunk.vertices);
+			writer.submit(std::move(chunk));
+		}
+	}
+
+	MeshChunk chunk = writer.acquire();
+	mb.takePending(chunk.vertices, chunk.faces);
+	writer.submit(std::move(chunk));
+
+	if (!writer.finish()) {
+		std::cerr << "cannot write " << targetName << '\n';
+		return false;
+	}
+	return true;
+}
+
+enum class MeshResult {
+	Written,
+	MissingSource,
+	WriteFailed,
+};
+
+MeshResult meshFile(MeshGenerator& mgen, ThreadPool& pool, const std::string& sourceName,
+	const std::string& targetName, PlyFormat format)
+{
 	CubeVector cv;
+	CubeHeader header;
 
 	{
-		std::fstream ifs{ "cubes.bin", std::ios::in | std::ios::binary };
-		cv = readCubes(ifs);
+		std::fstream ifs{ sourceName, std::ios::in | std::ios::binary };
+		if (!ifs)
+			return MeshResult::MissingSource;
+		header = readCubeHeader(ifs);
+		cv = readCubes(ifs, header, &pool);
 	}
 
-	for (auto& [cube, offset] : cv)
-		for (auto& tri : mgen.generateMesh(cube, offset))
-			mb.insertTriangle(tri);
+	return meshCubes(mgen, pool, cv, static_cast<float>(header.scale), targetName, format)
+		? MeshResult::Written : MeshResult::WriteFailed;
+}
 
-	{
-		std::ofstream ofs{ "out.ply", std::ios::out };
-		mb.writePLY(ofs);
+// optional arguments:
+//   --binary			write binary little endian PLY files
+//   --lod [level...]	mesh cubes_lod<level>.bin into out_lod<level>.ply for the given levels,
+//						or for every level found when none are given
+//   --batch manifest [threads]	mesh every "<cubes> <ply>" pair listed in the manifest in parallel
+//   --stats [cubes]		print counts, area, volume and bounds of the mesh without building it
+//   --sparse voxels [ply]	mesh a sparse run or voxel list (see SparseVolume::read) into out.ply
+int main(int argc, char* argv[]) try {
+	MeshGenerator mgen;
+	PlyFormat format = PlyFormat::Ascii;
+	ThreadPool pool;
+
+	if (argc > 1 && std::string_view{ argv[1] } == "--binary") {
+		format = PlyFormat::BinaryLittleEndian;
+		--argc, ++argv;
+	}
+
+	if (argc > 2 && std::string_view{ argv[1] } == "--batch") {
+		std::ifstream manifest{ argv[2] };
+		ThreadPool batchPool{ argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency() };
+		return runBatch(readManifest(manifest), format, batchPool, std::cout) ? 1 : 0;
+	}
+
+	if (argc > 1 && std::string_view{ argv[1] } == "--stats") {
+		std::ifstream ifs{ argc > 2 ? argv[2] : "cubes.bin", std::ios::in | std::ios::binary };
+		if (!ifs)
+			return 1;
+		const CubeHeader header = readCubeHeader(ifs);
+		std::cout << computeStats(readCubeCodes(ifs, header, &pool), header);
+		return 0;
 	}
 
-	return 0;
+	if (argc > 2 && std::string_view{ argv[1] } == "--sparse") {
+		std::ifstream ifs{ argv[2] };
+		if (!ifs)
+			return 1;
+		return meshCubes(mgen, pool, SparseVolume::read(ifs).activeCubes(), 1, argc > 3 ? argv[3] : "out.ply", format) ? 0 : 1;
+	}
+
+	if (argc > 1 && std::string_view{ argv[1] } == "--lod") {
+		const auto meshLevel = [&mgen, &pool, format](int level) {
+			const std::string suffix = std::to_string(level);
+			return meshFile(mgen, pool, "cubes_lod" + suffix + ".bin", "out_lod" + suffix + ".ply", format);
+		};
+
+		int failed = 0;
+		if (argc == 2) {
+			// the pyramid ends at the first missing level
+			for (int level = 0;; ++level) {
+				const MeshResult result = meshLevel(level);
+				if (result == MeshResult::MissingSource)
+					break;
+				failed += result == MeshResult::WriteFailed;
+			}
+		}
+		for (int i = 2; i < argc; ++i) {
+			const MeshResult result = meshLevel(std::stoi(argv[i]));
+			if (result == MeshResult::MissingSource)
+				std::cerr << "missing level " << argv[i] << '\n';
+			failed += result != MeshResult::Written;
+		}
+		return failed ? 1 : 0;
+	}
+
+	return meshFile(mgen, pool, "cubes.bin", "out.ply", format) == MeshResult::Written ? 0 : 1;
+}
+catch (const std::exception& e) {
+	std::cerr << e.what() << '\n';
+	return 1;
 }
@@ -0,0 +1,17 @@
+#include "manifest.hpp"
+#include <sstream>
+
+std::vector<BatchItem> readManifest(std::istream& ist) {
+	std::vector<BatchItem> items;
+
+	for (std::string line; std::getline(ist, line);) {
+		std::istringstream fields{ line };
+		BatchItem item;
+		if (!(fields >> item.source) || item.source.front() == '#')
+			continue;
+		if (fields >> item.target)
+			items.push_back(std::move(item));
+	}
+
+	return items;
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#pragma once
+#include <istream>
+#include <string>
+#include <vector>
+
+struct BatchItem {
+	std::string source, target;
+};
+
+// one "<source> <target>" pair per line, blank lines and lines starting with # are skipped
+std::vector<BatchItem> readManifest(std::istream& ist);
\ No newline at end of file
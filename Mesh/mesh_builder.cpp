@@ -1,8 +1,15 @@
 #include "mesh_builder.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <functional>
+#include <latch>
+#include <memory>
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 template <int32_t maxVal>
 struct BoundedValue {
@@ -37,10 +44,19 @@ bool Point::operator==(const Point& other) const {
     return floatIsZero(diff.x) && floatIsZero(diff.y) && floatIsZero(diff.z);
 }
 
-std::string getPLYHeader(std::size_t vertexCount, std::size_t faceCount) {
-    return
+std::string_view plyFormatName(PlyFormat format) {
+    switch (format) {
+    case PlyFormat::BinaryLittleEndian:
+        return "binary_little_endian";
+    default:
+        return "ascii";
+    }
+}
+
+std::string getPLYHeader(std::size_t vertexCount, std::size_t faceCount, PlyFormat format, std::size_t paddedSize) {
+    std::string header =
         "ply\n"
-        "format ascii 1.0\n"
+        "format " + std::string{ plyFormatName(format) } + " 1.0\n"
         "element vertex "
         + std::to_string(vertexCount) + '\n' +
         "property float x\n"
@@ -65,6 +81,16 @@ std::string getPLYHeader(std::size_t vertexCount, std::size_t faceCount) {
         //"property specular_coeff float\n"
         //"property specular_power float\n"
         "end_header\n";
+
+    // a comment line of spaces brings the header to a size reserved before the counts were known
+    constexpr std::string_view comment = "comment ";
+    const std::size_t formatLineEnd = header.find('\n', header.find("format")) + 1;
+    if (paddedSize >= header.size() + comment.size() + 1) {
+        const std::size_t spaces = paddedSize - header.size() - comment.size() - 1;
+        header.insert(formatLineEnd, std::string{ comment } + std::string(spaces, ' ') + '\n');
+    }
+
+    return header;
 }
 
 constexpr std::string_view materialString() {
@@ -74,23 +100,168 @@ constexpr std::string_view materialString() {
         "255 255 255 0.2 64\n";
 };
 
-void MeshBuilder::writePLY(std::ostream& ost) {
-    ost << getPLYHeader(m_vertices.size(), m_faces.size());
+// ASCII output matches what operator<< prints with the default stream settings
+// (6 significant digits, like %g), but without going through the stream per value
+template <typename T>
+char* formatValue(char* first, char* last, T value) {
+    if constexpr (std::is_floating_point_v<T>)
+        return std::to_chars(first, last, value, std::chars_format::general, 6).ptr;
+    else
+        return std::to_chars(first, last, value).ptr;
+}
+
+void appendPLYVertices(std::string& out, std::span<const Point> vertices) {
+    constexpr std::size_t maxLine = 3 * 16;
+    std::size_t used = out.size();
+    out.resize(used + vertices.size() * maxLine);
+
+    char* const last = out.data() + out.size();
+    char* p = out.data() + used;
+    for (const auto& [x, y, z] : vertices) {
+        p = formatValue(p, last, x);
+        *p++ = ' ';
+        p = formatValue(p, last, y);
+        *p++ = ' ';
+        p = formatValue(p, last, z);
+        *p++ = '\n';
+    }
+    out.resize(p - out.data());
+}
+
+void appendPLYFaces(std::string& out, std::span<const IndexedTriangle> faces) {
+    constexpr std::size_t maxLine = 2 + 3 * 12;
+    std::size_t used = out.size();
+    out.resize(used + faces.size() * maxLine);
 
-    for (const auto& [x, y, z] : m_vertices)
-        ost << x << ' ' << y << ' ' << z << /*' ' << '0' <<*/ '\n';
-    for (const auto& [p0, p1, p2] : m_faces)
-        ost << "3 " << p0 << ' ' << p1 << ' ' << p2 << '\n';
+    char* const last = out.data() + out.size();
+    char* p = out.data() + used;
+    for (const auto& [p0, p1, p2] : faces) {
+        *p++ = '3';
+        *p++ = ' ';
+        p = formatValue(p, last, p0);
+        *p++ = ' ';
+        p = formatValue(p, last, p1);
+        *p++ = ' ';
+        p = formatValue(p, last, p2);
+        *p++ = '\n';
+    }
+    out.resize(p - out.data());
+}
+
+constexpr std::size_t plyChunkItems = 1 << 14;
+
+void writePLYVertices(std::ostream& ost, std::span<const Point> vertices, PlyFormat format) {
+    if (format == PlyFormat::BinaryLittleEndian) {
+        ost.write(reinterpret_cast<const char*>(vertices.data()), vertices.size_bytes());
+        return;
+    }
+
+    std::string buffer;
+    for (std::size_t i = 0; i < vertices.size(); i += plyChunkItems) {
+        buffer.clear();
+        appendPLYVertices(buffer, vertices.subspan(i, std::min(plyChunkItems, vertices.size() - i)));
+        ost.write(buffer.data(), buffer.size());
+    }
+}
+
+void writePLYFaces(std::ostream& ost, std::span<const IndexedTriangle> faces, PlyFormat format) {
+    if (format == PlyFormat::BinaryLittleEndian) {
+        constexpr uint8_t vertexCount = 3;
+        for (const auto& face : faces) {
+            ost.write(reinterpret_cast<const char*>(&vertexCount), sizeof(vertexCount));
+            ost.write(reinterpret_cast<const char*>(face.data()), sizeof(face));
+        }
+        return;
+    }
+
+    std::string buffer;
+    for (std::size_t i = 0; i < faces.size(); i += plyChunkItems) {
+        buffer.clear();
+        appendPLYFaces(buffer, faces.subspan(i, std::min(plyChunkItems, faces.size() - i)));
+        ost.write(buffer.data(), buffer.size());
+    }
+}
+
+// chunks have a fixed size, so the output does not depend on the number of threads;
+// one window of chunks is formatted on the pool while the previous one is written
+void writePLYParallel(std::ostream& ost, std::span<const Point> vertices,
+    std::span<const IndexedTriangle> faces, ThreadPool& pool)
+{
+    const std::size_t vertexChunks = (vertices.size() + plyChunkItems - 1) / plyChunkItems;
+    const std::size_t faceChunks = (faces.size() + plyChunkItems - 1) / plyChunkItems;
+    const std::size_t chunkCount = vertexChunks + faceChunks;
+    const std::size_t window = 2 * pool.size();
+    const std::size_t windowCount = (chunkCount + window - 1) / window;
+
+    std::vector<std::string> buffers[2] = { std::vector<std::string>(window), std::vector<std::string>(window) };
+    std::vector<std::unique_ptr<std::latch>> done(windowCount);
+
+    const auto formatChunk = [&](std::size_t chunk, std::string& out) {
+        out.clear();
+        if (chunk < vertexChunks) {
+            const std::size_t first = chunk * plyChunkItems;
+            appendPLYVertices(out, vertices.subspan(first, std::min(plyChunkItems, vertices.size() - first)));
+        }
+        else {
+            const std::size_t first = (chunk - vertexChunks) * plyChunkItems;
+            appendPLYFaces(out, faces.subspan(first, std::min(plyChunkItems, faces.size() - first)));
+        }
+    };
+    const auto windowSize = [&](std::size_t w) {
+        return std::min(window, chunkCount - w * window);
+    };
+    // a chunk that fails to format still counts down, so the writer never waits forever;
+    // nothing is written after it and pool.wait() rethrows the error
+    std::atomic<bool> failed = false;
+    const auto submitWindow = [&](std::size_t w) {
+        done[w] = std::make_unique<std::latch>(windowSize(w));
+        for (std::size_t i = 0; i < windowSize(w); ++i) {
+            pool.submit([&, w, i]() {
+                try {
+                    formatChunk(w * window + i, buffers[w % 2][i]);
+                }
+                catch (...) {
+                    failed = true;
+                    done[w]->count_down();
+                    throw;
+                }
+                done[w]->count_down();
+            });
+        }
+    };
+
+    if (windowCount)
+        submitWindow(0);
+    for (std::size_t w = 0; w < windowCount && !failed; ++w) {
+        if (w + 1 < windowCount)
+            submitWindow(w + 1);
+        done[w]->wait();
+        for (std::size_t i = 0; i < windowSize(w) && !failed; ++i)
+            ost.write(buffers[w % 2][i].data(), buffers[w % 2][i].size());
+    }
+    // tasks may still be returning after their count_down
+    pool.wait();
+}
+
+void MeshBuilder::writePLY(std::ostream& ost, PlyFormat format, ThreadPool* pool) {
+    ost << getPLYHeader(m_vertices.size(), m_faces.size(), format);
+
+    if (pool && format == PlyFormat::Ascii) {
+        writePLYParallel(ost, m_vertices, m_faces, *pool);
+        return;
+    }
+
+    writePLYVertices(ost, m_vertices, format);
+    writePLYFaces(ost, m_faces, format);
     //ost << materialString();
 }
 
 int32_t MeshBuilder::insertVertex(const Point &p) {
-	if (m_index.contains(p))
-        return m_index.at(p);
-
-	m_vertices.push_back(p);
-	return m_index[p] = static_cast<int32_t>(m_vertices.size()) - 1;
-	
+    // a single lookup whether or not the vertex is new
+    const auto [it, inserted] = m_index.try_emplace(p, static_cast<int32_t>(m_takenVertices + m_vertices.size()));
+    if (inserted)
+        m_vertices.push_back(p);
+    return it->second;
 }
 
 void MeshBuilder::insertTriangle(const Triangle& tri) {
@@ -108,6 +279,27 @@ void MeshBuilder::clear() {
     m_faces.clear();
     m_vertices.clear();
     m_index.clear();
+    m_takenVertices = 0;
+}
+
+std::size_t MeshBuilder::pendingVertexCount() const {
+    return m_vertices.size();
+}
+
+std::size_t MeshBuilder::pendingFaceCount() const {
+    return m_faces.size();
+}
+
+void MeshBuilder::takePending(std::vector<Point>& vertices, std::vector<IndexedTriangle>& faces) {
+    takePendingVertices(vertices);
+    faces.clear();
+    std::swap(faces, m_faces);
+}
+
+void MeshBuilder::takePendingVertices(std::vector<Point>& vertices) {
+    vertices.clear();
+    std::swap(vertices, m_vertices);
+    m_takenVertices += vertices.size();
 }
 
 Mesh MeshBuilder::getMesh() const {
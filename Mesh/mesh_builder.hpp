@@ -2,7 +2,10 @@
 #include <array>
 #include <cmath>
 #include <cstdint>
+#include <iosfwd>
 #include <limits>
+#include <span>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -18,6 +21,7 @@ struct Point {
     Point operator-(const Point& other) const {
         return operator+(-other);
     };
+    Point operator*(float s) const { return { x * s, y * s, z * s }; }
 
     float squareLength() const { return x * x + y * y + z * z; }
 };
@@ -26,6 +30,13 @@ using Triangle = std::array<Point, 3>;
 using IndexedTriangle = std::array<int32_t, 3>;
 using Polygon = std::vector<Point>;
 
+class ThreadPool;
+
+enum class PlyFormat {
+    Ascii,
+    BinaryLittleEndian,
+};
+
 bool floatIsZero(float x);
 float tripleProduct(const Point& a, const Point& b, const Point& c);
 bool coplanar(const std::array<Point, 4>& pts);
@@ -48,11 +59,23 @@ struct Mesh {
     std::vector<IndexedTriangle> faces;
 };
 
+// paddedSize > 0 pads the header with a comment line to exactly that many bytes
+std::string getPLYHeader(std::size_t vertexCount, std::size_t faceCount,
+    PlyFormat format = PlyFormat::Ascii, std::size_t paddedSize = 0);
+void appendPLYVertices(std::string& out, std::span<const Point> vertices);
+void appendPLYFaces(std::string& out, std::span<const IndexedTriangle> faces);
+void writePLYVertices(std::ostream& ost, std::span<const Point> vertices, PlyFormat format);
+void writePLYFaces(std::ostream& ost, std::span<const IndexedTriangle> faces, PlyFormat format);
+// ASCII only; output is byte-identical to the serial writers for any pool size
+void writePLYParallel(std::ostream& ost, std::span<const Point> vertices,
+    std::span<const IndexedTriangle> faces, ThreadPool& pool);
+
 class MeshBuilder {
 private:
     std::vector<Point> m_vertices;
     std::vector<IndexedTriangle> m_faces;
     std::unordered_map<Point, int32_t> m_index;
+    std::size_t m_takenVertices = 0;
 public:
     MeshBuilder() = default;
 
@@ -61,6 +84,15 @@ public:
     void insertPolygon(const Polygon& poly);
     void clear();
 
+    // hands out the vertices and faces added since the last call, swapping in the
+    // given buffers for reuse; indices of later faces keep counting from where they left off
+    std::size_t pendingVertexCount() const;
+    std::size_t pendingFaceCount() const;
+    void takePending(std::vector<Point>& vertices, std::vector<IndexedTriangle>& faces);
+    // the same for the vertices alone; the faces stay until the next takePending
+    void takePendingVertices(std::vector<Point>& vertices);
+
     Mesh getMesh() const;
-    void writePLY(std::ostream& ost);
+    // ASCII output is formatted on the pool when one is given
+    void writePLY(std::ostream& ost, PlyFormat format = PlyFormat::Ascii, ThreadPool* pool = nullptr);
 };
\ No newline at end of file
@@ -2,16 +2,18 @@
 #include "cube_processing.hpp"
 #include <algorithm>
 
-std::vector<Triangle> MeshGenerator::generateMesh(const Cube& cube, const Point& offset) {
-	const auto makeTriangle = [offset](const IndexedTriangle &itri)->Triangle {
+MeshGenerator::MeshGenerator() : cubeIndex(sharedTable()) {}
+
+std::vector<Triangle> MeshGenerator::generateMesh(const Cube& cube, const Point& offset, float scale) {
+	const auto makeTriangle = [offset, scale](const IndexedTriangle &itri)->Triangle {
 		return {
-			edgePoint(itri[0]) + offset,
-			edgePoint(itri[1]) + offset,
-			edgePoint(itri[2]) + offset
+			edgePoint(itri[0]) * scale + offset,
+			edgePoint(itri[1]) * scale + offset,
+			edgePoint(itri[2]) * scale + offset
 		};
 	};
 
-	const auto& indexedTris = *cubeIndex[emplaceCube(cube)];
+	const auto& indexedTris = cubeIndex[cube.to_ulong()];
 	std::vector<Triangle> result(indexedTris.size());
 
 	std::transform(indexedTris.begin(), indexedTris.end(), result.begin(), makeTriangle);
@@ -30,21 +32,26 @@ auto meshTriangles(const Mesh& mesh) {
 	return result;
 }
 
-int MeshGenerator::emplaceCube(const Cube& cube) {
-	const int index = static_cast<int>(cube.to_ulong());
+const MeshGenerator::CubeTable& MeshGenerator::sharedTable() {
+	static const CubeTable table = []() {
+		CubeTable result;
+		for (int index = 0; index < 256; ++index)
+			result[index] = buildCube(index);
+		return result;
+	}();
 
-	if (!cubeIndex[index]) {
-		MeshBuilder mb;
+	return table;
+}
 
-		for (const auto& poly : getCubePolygons(cube))
-			mb.insertPolygon(poly);
+std::vector<std::array<int, 3>> MeshGenerator::buildCube(const Cube& cube) {
+	MeshBuilder mb;
 
-		Mesh mesh = mb.getMesh();
-		fixNormals(cube, mesh);
-		cubeIndex[index] = meshTriangles(mesh);
-	}
+	for (const auto& poly : getCubePolygons(cube))
+		mb.insertPolygon(poly);
 
-	return index;
+	Mesh mesh = mb.getMesh();
+	fixNormals(cube, mesh);
+	return meshTriangles(mesh);
 }
 
 Point vec(int from, int to, const Mesh& mesh) {
@@ -1,16 +1,22 @@
 #pragma once
 #include "mesh_builder.hpp"
 #include "cube_processing.hpp"
-#include <optional>
+#include <array>
+#include <vector>
 
 class MeshGenerator {
 private:
-	std::array<std::optional<std::vector<std::array<int, 3>>>, 256> cubeIndex;
+	using CubeTable = std::array<std::vector<std::array<int, 3>>, 256>;
+
+	// built once per process and shared by every generator, so generators are cheap
+	// and can be used from several threads at once
+	const CubeTable& cubeIndex;
 public:
-	MeshGenerator() = default;
+	MeshGenerator();
 
-	std::vector<Triangle> generateMesh(const Cube& cube, const Point& offset = {});
+	std::vector<Triangle> generateMesh(const Cube& cube, const Point& offset = {}, float scale = 1);
 private:
-	int emplaceCube(const Cube& cube);
+	static const CubeTable& sharedTable();
+	static std::vector<std::array<int, 3>> buildCube(const Cube& cube);
 	static void fixNormals(const Cube& cube, Mesh &mesh);
 };
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "mesh_stats.hpp"
+#include "mesh_generator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <vector>
+
+namespace {
+	// cube corners in the order of the code bits, in local mesh coordinates
+	constexpr std::array<std::array<int, 3>, 8> cornerPositions = { {
+		{ 0, 0, 0 }, { 2, 0, 0 }, { 2, 0, 2 }, { 0, 0, 2 },
+		{ 0, 2, 0 }, { 2, 2, 0 }, { 2, 2, 2 }, { 0, 2, 2 },
+	} };
+
+	// corner pairs of the 12 edges, matching the edge points of cube_processing.cpp
+	constexpr std::array<std::pair<int, int>, 12> edgeCorners = { {
+		{ 0,1 }, { 1,2 }, { 2,3 }, { 3,0 }, { 4,5 }, { 5,6 },
+		{ 6,7 }, { 7,4 }, { 0,4 }, { 1,5 }, { 2,6 }, { 3,7 },
+	} };
+
+	Point cross(const Point& a, const Point& b) {
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	double dot(const Point& a, const Point& b) {
+		return static_cast<double>(a.x) * b.x + static_cast<double>(a.y) * b.y + static_cast<double>(a.z) * b.z;
+	}
+
+	struct CodeStats {
+		int64_t faces = 0;
+		double area = 0;
+		// sum of p0 . n and of n over the triangles, n = (p1 - p0) x (p2 - p0)
+		double volumeTerm = 0;
+		Point normalSum{};
+		Point min{}, max{};
+		// per axis: bit axis when min is 0, bit 3 + axis when max is 2 (otherwise both are 1)
+		uint8_t extent = 0;
+		// sign changing edges the cube is counted for, by which of its sides lie on the
+		// upper edge of the grid: bit 0 for x, 1 for y, 2 for z
+		std::array<int64_t, 8> ownedEdges{};
+	};
+
+	// a vertex sits on every edge with a sign change; each cube counts its edges that touch
+	// the low sides of the cube, plus the ones on a side that has no neighbour to count them
+	int64_t ownedEdgeCount(int code, int upperSides) {
+		int64_t count = 0;
+
+		for (auto [a, b] : edgeCorners) {
+			if (((code >> a) & 1) == ((code >> b) & 1))
+				continue;
+			bool owned = true;
+			for (int axis = 0; axis < 3; ++axis) {
+				const bool along = cornerPositions[a][axis] != cornerPositions[b][axis];
+				if (!along && cornerPositions[a][axis] == 2 && !((upperSides >> axis) & 1))
+					owned = false;
+			}
+			count += owned;
+		}
+
+		return count;
+	}
+
+	const std::array<CodeStats, 256>& codeTable() {
+		static const std::array<CodeStats, 256> table = []() {
+			std::array<CodeStats, 256> result;
+			MeshGenerator mgen;
+
+			for (int code = 0; code < 256; ++code) {
+				CodeStats& stats = result[code];
+				const auto triangles = mgen.generateMesh(code);
+				constexpr float inf = std::numeric_limits<float>::infinity();
+				stats.min = { inf, inf, inf };
+				stats.max = { -inf, -inf, -inf };
+
+				for (const auto& [p0, p1, p2] : triangles) {
+					const Point n = cross(p1 - p0, p2 - p0);
+					stats.area += std::sqrt(dot(n, n)) / 2;
+					stats.volumeTerm += dot(p0, n);
+					stats.normalSum = stats.normalSum + n;
+					for (const Point& p : { p0, p1, p2 }) {
+						stats.min = { std::min(stats.min.x, p.x), std::min(stats.min.y, p.y), std::min(stats.min.z, p.z) };
+						stats.max = { std::max(stats.max.x, p.x), std::max(stats.max.y, p.y), std::max(stats.max.z, p.z) };
+					}
+				}
+
+				stats.faces = static_cast<int64_t>(triangles.size());
+				if (stats.faces) {
+					const float lo[] = { stats.min.x, stats.min.y, stats.min.z };
+					const float hi[] = { stats.max.x, stats.max.y, stats.max.z };
+					for (int axis = 0; axis < 3; ++axis)
+						stats.extent |= ((lo[axis] == 0) << axis) | ((hi[axis] == 2) << (3 + axis));
+				}
+				for (int sides = 0; sides < 8; ++sides)
+					stats.ownedEdges[sides] = ownedEdgeCount(code, sides);
+			}
+
+			return result;
+		}();
+
+		return table;
+	}
+
+	// per code: cube count and sums of the cube indices
+	struct CodeHistogram {
+		std::array<int64_t, 256> count{}, sumX{}, sumY{}, sumZ{};
+		// cubes on the upper sides of the grid, by side mask (mask 0 is implied by count)
+		std::array<std::array<int64_t, 256>, 8> sideCount{};
+	};
+}
+
+MeshStats computeStats(std::span<const uint8_t> codes, const CubeHeader& header) {
+	const auto [cx, cy, cz] = header.count;
+	const auto& table = codeTable();
+	CodeHistogram hist;
+	std::array<uint8_t, 256> extent;
+	for (int code = 0; code < 256; ++code)
+		extent[code] = table[code].extent;
+
+	const double scale = static_cast<double>(header.scale);
+	const auto [base, step] = cubeFrame(header);
+	constexpr double inf = std::numeric_limits<double>::infinity();
+	std::array<double, 3> lo = { inf, inf, inf }, hi = { -inf, -inf, -inf };
+
+	// the single pass over the codes: a handful of additions per cube, no geometry
+	for (int64_t z = 0, i = 0; z < cz; ++z) {
+		for (int64_t y = 0; y < cy; ++y, i += cx) {
+			const uint8_t* row = codes.data() + i;
+			uint8_t rowExtent = 0;
+			for (int64_t x = 0; x < cx; ++x) {
+				const uint8_t code = row[x];
+				++hist.count[code];
+				hist.sumX[code] += x;
+				hist.sumY[code] += y;
+				hist.sumZ[code] += z;
+				rowExtent |= extent[code];
+			}
+
+			// cubes on the upper sides of the grid, in mesh terms: last x, first y, last z
+			const int sides = ((y == 0) << 1) | ((z == cz - 1) << 2);
+			if (sides) {
+				for (int64_t x = 0; x < cx; ++x)
+					++hist.sideCount[sides | (x == cx - 1)][row[x]];
+			}
+			else {
+				++hist.sideCount[1][row[cx - 1]];
+			}
+
+			// bounds: along the row only the first and last surface cube can extend them
+			if (!rowExtent)
+				continue;
+			const auto surface = [&table](uint8_t code) { return table[code].faces != 0; };
+			const int64_t first = std::find_if(row, row + cx, surface) - row;
+			const int64_t last = cx - 1 - (std::find_if(std::make_reverse_iterator(row + cx), std::make_reverse_iterator(row), surface) - std::make_reverse_iterator(row + cx));
+			const double yOffset = base[1] + step[1] * y, zOffset = base[2] + step[2] * z;
+
+			lo[0] = std::min(lo[0], base[0] + step[0] * first + scale * table[row[first]].min.x);
+			hi[0] = std::max(hi[0], base[0] + step[0] * last + scale * table[row[last]].max.x);
+			lo[1] = std::min(lo[1], yOffset + scale * ((rowExtent & 0b000010) ? 0 : 1));
+			hi[1] = std::max(hi[1], yOffset + scale * ((rowExtent & 0b010000) ? 2 : 1));
+			lo[2] = std::min(lo[2], zOffset + scale * ((rowExtent & 0b000100) ? 0 : 1));
+			hi[2] = std::max(hi[2], zOffset + scale * ((rowExtent & 0b100000) ? 2 : 1));
+		}
+	}
+
+	MeshStats stats;
+	stats.min = { static_cast<float>(lo[0]), static_cast<float>(lo[1]), static_cast<float>(lo[2]) };
+	stats.max = { static_cast<float>(hi[0]), static_cast<float>(hi[1]), static_cast<float>(hi[2]) };
+
+	for (int code = 0; code < 256; ++code) {
+		const CodeStats& c = table[code];
+		const int64_t count = hist.count[code];
+		if (!count)
+			continue;
+
+		// cubes off the upper sides own only their low edges
+		int64_t interior = count;
+		for (int sides = 1; sides < 8; ++sides) {
+			interior -= hist.sideCount[sides][code];
+			stats.vertexCount += hist.sideCount[sides][code] * c.ownedEdges[sides];
+		}
+		stats.vertexCount += interior * c.ownedEdges[0];
+		if (!c.faces)
+			continue;
+
+		stats.faceCount += count * c.faces;
+		stats.area += count * c.area * scale * scale;
+
+		// divergence theorem over the translated, scaled triangles:
+		// (s q0 + o) . (s^2 n) = s^3 q0 . n + s^2 o . n, summed over every cube of the code
+		const double sumOffset[] = {
+			base[0] * count + step[0] * hist.sumX[code],
+			base[1] * count + step[1] * hist.sumY[code],
+			base[2] * count + step[2] * hist.sumZ[code],
+		};
+		stats.volume += (count * c.volumeTerm * scale * scale * scale + scale * scale *
+			(sumOffset[0] * c.normalSum.x + sumOffset[1] * c.normalSum.y + sumOffset[2] * c.normalSum.z)) / 6;
+	}
+
+	return stats;
+}
+
+std::ostream& operator<<(std::ostream& ost, const MeshStats& stats) {
+	return ost
+		<< "vertices " << stats.vertexCount << '\n'
+		<< "faces " << stats.faceCount << '\n'
+		<< "area " << stats.area << '\n'
+		<< "volume " << stats.volume << '\n'
+		<< "min " << stats.min.x << ' ' << stats.min.y << ' ' << stats.min.z << '\n'
+		<< "max " << stats.max.x << ' ' << stats.max.y << ' ' << stats.max.z << '\n';
+}
\ No newline at end of file
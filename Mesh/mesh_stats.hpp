@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <span>
+
+#include "binary_cube_reader.hpp"
+#include "mesh_builder.hpp"
+
+struct MeshStats {
+	int64_t vertexCount = 0, faceCount = 0;
+	double area = 0, volume = 0;
+	Point min{}, max{};
+};
+
+// the numbers the mesh of these codes would have, in the frame of the PLY written by Mesh,
+// from a histogram of the codes instead of the mesh itself; volume is the volume enclosed
+// by the surface, which is open where the occupied region touches the edge of the grid
+MeshStats computeStats(std::span<const uint8_t> codes, const CubeHeader& header);
+
+std::ostream& operator<<(std::ostream& ost, const MeshStats& stats);
\ No newline at end of file
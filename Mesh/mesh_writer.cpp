@@ -0,0 +1,80 @@
+#include "mesh_writer.hpp"
+#include <cstdint>
+#include <limits>
+
+AsyncMeshWriter::AsyncMeshWriter(std::string path, PlyFormat format, ThreadPool* pool, std::size_t chunkCount) :
+	m_path(std::move(path)), m_format(format), m_pool(pool), m_filled(chunkCount), m_free(chunkCount)
+{
+	// the counts are only known at the end, so room for the largest ones is reserved
+	constexpr std::size_t maxCount = std::numeric_limits<std::size_t>::max();
+	m_headerSize = getPLYHeader(maxCount, maxCount, m_format).size() + sizeof("comment \n");
+
+	for (std::size_t i = 0; i < chunkCount; ++i)
+		m_free.push({});
+	m_thread = std::thread{ &AsyncMeshWriter::run, this };
+}
+
+AsyncMeshWriter::~AsyncMeshWriter() {
+	finish();
+}
+
+MeshChunk AsyncMeshWriter::acquire() {
+	return m_free.pop();
+}
+
+void AsyncMeshWriter::submit(MeshChunk&& chunk) {
+	m_filled.push(std::move(chunk));
+}
+
+bool AsyncMeshWriter::finish() {
+	if (m_finished)
+		return m_written;
+
+	MeshChunk chunk = acquire();
+	chunk.vertices.clear();
+	chunk.faces.clear();
+	chunk.last = true;
+	submit(std::move(chunk));
+
+	m_thread.join();
+	m_finished = true;
+	return m_written;
+}
+
+void AsyncMeshWriter::run() {
+	std::ofstream output{ m_path, std::ios::binary | std::ios::out };
+	std::size_t vertexCount = 0, faceCount = 0;
+
+	// after a failure the chunks are still drained, so the mesher never blocks
+	output << std::string(m_headerSize, ' ');
+	for (MeshChunk chunk = m_filled.pop(); !chunk.last; chunk = m_filled.pop()) {
+		// a vertex after the first face would land inside the face section
+		if (faceCount && !chunk.vertices.empty())
+			output.setstate(std::ios::failbit);
+
+		// an error escaping this thread would terminate the program, so it only fails the file
+		try {
+			if (output && m_pool && m_format == PlyFormat::Ascii) {
+				writePLYParallel(output, chunk.vertices, chunk.faces, *m_pool);
+			}
+			else if (output) {
+				writePLYVertices(output, chunk.vertices, m_format);
+				writePLYFaces(output, chunk.faces, m_format);
+			}
+		}
+		catch (...) {
+			output.setstate(std::ios::failbit);
+		}
+		vertexCount += chunk.vertices.size();
+		faceCount += chunk.faces.size();
+
+		chunk.vertices.clear();
+		chunk.faces.clear();
+		m_free.push(std::move(chunk));
+	}
+
+	output.seekp(0);
+	output << getPLYHeader(vertexCount, faceCount, m_format, m_headerSize);
+	output.close();
+	m_written = !output.fail();
+}
\ No newline at end of file
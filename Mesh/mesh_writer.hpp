@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mesh_builder.hpp"
+
+// bounded lock-free queue for exactly one producer and one consumer thread;
+// push blocks while the queue is full and pop while it is empty
+template <typename T>
+class SpscQueue {
+private:
+	std::vector<T> m_slots;
+	alignas(64) std::atomic<std::size_t> m_head = 0;
+	alignas(64) std::atomic<std::size_t> m_tail = 0;
+public:
+	explicit SpscQueue(std::size_t capacity) : m_slots(capacity) {}
+
+	void push(T&& value) {
+		const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+		for (std::size_t head; tail - (head = m_head.load(std::memory_order_acquire)) == m_slots.size();)
+			m_head.wait(head, std::memory_order_acquire);
+
+		m_slots[tail % m_slots.size()] = std::move(value);
+		m_tail.store(tail + 1, std::memory_order_release);
+		m_tail.notify_one();
+	}
+
+	T pop() {
+		const std::size_t head = m_head.load(std::memory_order_relaxed);
+		for (std::size_t tail; (tail = m_tail.load(std::memory_order_acquire)) == head;)
+			m_tail.wait(tail, std::memory_order_acquire);
+
+		T value = std::move(m_slots[head % m_slots.size()]);
+		m_head.store(head + 1, std::memory_order_release);
+		m_head.notify_one();
+		return value;
+	}
+};
+
+struct MeshChunk {
+	std::vector<Point> vertices;
+	std::vector<IndexedTriangle> faces;
+	bool last = false;
+};
+
+// writes a PLY file on its own thread from chunks filled by the mesher;
+// a fixed set of chunks circulates between the two threads, so a slow disk
+// stalls the mesher instead of growing memory.
+// chunks are written in order straight after the header, so every vertex
+// has to be submitted before the first face
+class AsyncMeshWriter {
+private:
+	std::string m_path;
+	PlyFormat m_format;
+	ThreadPool* m_pool;
+	std::size_t m_headerSize;
+	SpscQueue<MeshChunk> m_filled, m_free;
+	std::thread m_thread;
+	bool m_finished = false, m_written = false;
+public:
+	// ASCII chunks are formatted on the pool when one is given
+	AsyncMeshWriter(std::string path, PlyFormat format = PlyFormat::Ascii, ThreadPool* pool = nullptr,
+		std::size_t chunkCount = 4);
+	~AsyncMeshWriter();
+
+	MeshChunk acquire();
+	void submit(MeshChunk&& chunk);
+	// false when the file could not be written completely
+	bool finish();
+private:
+	void run();
+};
\ No newline at end of file
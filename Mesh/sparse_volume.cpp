@@ -0,0 +1,155 @@
+#include "sparse_volume.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+SparseVolume::SparseVolume(const std::array<int64_t, 3>& size, std::vector<std::array<int64_t, 4>> runs) :
+	m_size(size)
+{
+	for (auto& [y, z, x0, x1] : runs) {
+		x0 = std::max<int64_t>(x0, 0);
+		x1 = std::min(x1, m_size[0]);
+	}
+	std::erase_if(runs, [this](const std::array<int64_t, 4>& run) {
+		const auto [y, z, x0, x1] = run;
+		return x0 >= x1 || y < 0 || y >= m_size[1] || z < 0 || z >= m_size[2];
+	});
+	std::sort(runs.begin(), runs.end(), [this](const auto& a, const auto& b) {
+		return std::pair{ rowKey(a[0], a[1]), a[2] } < std::pair{ rowKey(b[0], b[1]), b[2] };
+	});
+
+	for (const auto& [y, z, x0, x1] : runs) {
+		const int64_t key = rowKey(y, z);
+		if (m_rowKeys.empty() || m_rowKeys.back() != key) {
+			m_rowKeys.push_back(key);
+			m_rowStart.push_back(m_runs.size());
+		}
+		else if (x0 <= m_runs.back().second) {
+			m_runs.back().second = std::max(m_runs.back().second, x1);
+			continue;
+		}
+		m_runs.emplace_back(x0, x1);
+	}
+	m_rowStart.push_back(m_runs.size());
+}
+
+SparseVolume SparseVolume::fromVoxels(const std::array<int64_t, 3>& size, const std::vector<std::array<int64_t, 3>>& voxels) {
+	std::vector<std::array<int64_t, 4>> runs;
+	runs.reserve(voxels.size());
+
+	for (const auto& [x, y, z] : voxels)
+		runs.push_back({ y, z, x, x + 1 });
+
+	return { size, std::move(runs) };
+}
+
+SparseVolume SparseVolume::read(std::istream& ist) {
+	std::string kind;
+	std::array<int64_t, 3> size{};
+	ist >> kind >> size[0] >> size[1] >> size[2];
+
+	if (kind == "runs") {
+		std::vector<std::array<int64_t, 4>> runs;
+		for (std::array<int64_t, 4> run; ist >> run[0] >> run[1] >> run[2] >> run[3];)
+			runs.push_back(run);
+		return { size, std::move(runs) };
+	}
+	if (kind == "voxels") {
+		std::vector<std::array<int64_t, 3>> voxels;
+		for (std::array<int64_t, 3> voxel; ist >> voxel[0] >> voxel[1] >> voxel[2];)
+			voxels.push_back(voxel);
+		return fromVoxels(size, voxels);
+	}
+
+	throw std::runtime_error("Unknown sparse volume format: " + kind);
+}
+
+std::array<int64_t, 3> SparseVolume::cubeCount() const {
+	return { m_size[0] - 1, m_size[1] - 1, m_size[2] - 1 };
+}
+
+int64_t SparseVolume::rowKey(int64_t y, int64_t z) const {
+	return y + m_size[1] * z;
+}
+
+std::span<const SparseVolume::Run> SparseVolume::row(int64_t y, int64_t z) const {
+	const auto it = std::lower_bound(m_rowKeys.begin(), m_rowKeys.end(), rowKey(y, z));
+	if (it == m_rowKeys.end() || *it != rowKey(y, z))
+		return {};
+
+	const std::size_t i = it - m_rowKeys.begin();
+	return { m_runs.data() + m_rowStart[i], m_runs.data() + m_rowStart[i + 1] };
+}
+
+CubeVector SparseVolume::activeCubes() const {
+	const auto [cx, cy, cz] = cubeCount();
+	std::vector<int64_t> cubeRows;
+	CubeVector cubes;
+
+	// every nonempty row is a corner row of up to four rows of cubes
+	for (int64_t key : m_rowKeys) {
+		const int64_t y = key % m_size[1], z = key / m_size[1];
+		for (int64_t dz = -1; dz <= 0; ++dz)
+			for (int64_t dy = -1; dy <= 0; ++dy)
+				if (y + dy >= 0 && y + dy < cy && z + dz >= 0 && z + dz < cz)
+					cubeRows.push_back(rowKey(y + dy, z + dz));
+	}
+	std::sort(cubeRows.begin(), cubeRows.end());
+	cubeRows.erase(std::unique(cubeRows.begin(), cubeRows.end()), cubeRows.end());
+
+	for (int64_t key : cubeRows)
+		appendRowCubes(key % m_size[1], key / m_size[1], cubes);
+
+	return cubes;
+}
+
+// walks the run boundaries of the four corner rows; between two boundaries every corner
+// row is constant, so a cube there is either uniform and skipped or repeats the same code
+void SparseVolume::appendRowCubes(int64_t y, int64_t z, CubeVector& cubes) const {
+	// corner rows in the bit order of GridArray::cubeAt: (y + 1, z), (y + 1, z + 1), (y, z), (y, z + 1)
+	const std::array<std::span<const Run>, 4> rows = { row(y + 1, z), row(y + 1, z + 1), row(y, z), row(y, z + 1) };
+	constexpr int leftBit[] = { 0, 3, 4, 7 }, rightBit[] = { 1, 2, 5, 6 };
+	const float yOffset = 2.0f * (m_size[1] - 2 - y), zOffset = 2.0f * z;
+	const int64_t cx = m_size[0] - 1;
+
+	std::vector<int64_t> bounds;
+	for (const auto& runs : rows)
+		for (const auto& [x0, x1] : runs)
+			bounds.insert(bounds.end(), { x0, x1 });
+	std::sort(bounds.begin(), bounds.end());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+	std::array<std::size_t, 4> next{};
+	const auto valuesAt = [&](int64_t x) {
+		int values = 0;
+		for (int r = 0; r < 4; ++r) {
+			while (next[r] < rows[r].size() && rows[r][next[r]].second <= x)
+				++next[r];
+			values |= (next[r] < rows[r].size() && rows[r][next[r]].first <= x) << r;
+		}
+		return values;
+	};
+	const auto code = [&](int left, int right) {
+		int bits = 0;
+		for (int r = 0; r < 4; ++r)
+			bits |= (((left >> r) & 1) << leftBit[r]) | (((right >> r) & 1) << rightBit[r]);
+		return bits;
+	};
+	const auto emit = [&](int64_t from, int64_t to, int bits) {
+		if (bits == 0 || bits == 255)
+			return;
+		for (int64_t x = std::max<int64_t>(from, 0); x < std::min(to, cx); ++x)
+			cubes.push_back({ Cube(bits), { 2.0f * x, yOffset, zOffset } });
+	};
+
+	// rows are empty before the first boundary, so that segment is never emitted
+	for (std::size_t k = 0; k < bounds.size(); ++k) {
+		const int64_t start = bounds[k];
+		const int64_t end = (k + 1 < bounds.size()) ? bounds[k + 1] : m_size[0];
+		const int before = valuesAt(start - 1), inside = valuesAt(start);
+
+		emit(start - 1, start, code(before, inside));
+		emit(start, end - 1, code(inside, inside));
+	}
+}
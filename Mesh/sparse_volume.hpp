@@ -0,0 +1,38 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "binary_cube_reader.hpp"
+#include "cube_processing.hpp"
+
+// occupied voxels kept as sorted runs along x, one list per nonempty (y, z) row;
+// everything scales with the object, never with the size of the domain
+class SparseVolume {
+public:
+	using Run = std::pair<int64_t, int64_t>;
+private:
+	std::array<int64_t, 3> m_size;
+	std::vector<int64_t> m_rowKeys;
+	std::vector<std::size_t> m_rowStart;
+	std::vector<Run> m_runs;
+public:
+	// runs given as { y, z, first x, last x + 1 } in any order, overlapping runs are merged
+	SparseVolume(const std::array<int64_t, 3>& size, std::vector<std::array<int64_t, 4>> runs);
+	static SparseVolume fromVoxels(const std::array<int64_t, 3>& size, const std::vector<std::array<int64_t, 3>>& voxels);
+
+	// text: "runs w h d" followed by "y z x0 x1" lines, or "voxels w h d" followed by "x y z" lines
+	static SparseVolume read(std::istream& ist);
+
+	std::array<int64_t, 3> cubeCount() const;
+	// the cubes that cross the surface, with offsets in the frame readCubes uses;
+	// cubes that are entirely inside or outside are never visited
+	CubeVector activeCubes() const;
+private:
+	int64_t rowKey(int64_t y, int64_t z) const;
+	std::span<const Run> row(int64_t y, int64_t z) const;
+	void appendRowCubes(int64_t y, int64_t z, CubeVector& cubes) const;
+};
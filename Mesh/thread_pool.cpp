@@ -0,0 +1,69 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <utility>
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+	threadCount = std::max<std::size_t>(threadCount, 1);
+	for (std::size_t i = 0; i < threadCount; ++i)
+		m_workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock{ m_mutex };
+		m_stopping = true;
+	}
+	m_taskReady.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+std::size_t ThreadPool::size() const {
+	return m_workers.size();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard lock{ m_mutex };
+		m_tasks.push(std::move(task));
+	}
+	m_taskReady.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock lock{ m_mutex };
+	m_idle.wait(lock, [this]() { return m_tasks.empty() && m_running == 0; });
+
+	if (m_error)
+		std::rethrow_exception(std::exchange(m_error, nullptr));
+}
+
+void ThreadPool::work() {
+	std::unique_lock lock{ m_mutex };
+
+	while (true) {
+		m_taskReady.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+		if (m_tasks.empty())
+			return;
+
+		std::function<void()> task = std::move(m_tasks.front());
+		m_tasks.pop();
+		++m_running;
+
+		lock.unlock();
+		std::exception_ptr error;
+		try {
+			task();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+
+		if (error && !m_error)
+			m_error = error;
+		if (--m_running == 0 && m_tasks.empty())
+			m_idle.notify_all();
+	}
+}
\ No newline at end of file
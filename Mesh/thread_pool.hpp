@@ -0,0 +1,31 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+private:
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_taskReady, m_idle;
+	std::size_t m_running = 0;
+	bool m_stopping = false;
+	std::exception_ptr m_error;
+public:
+	explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	std::size_t size() const;
+	void submit(std::function<void()> task);
+	// blocks until every submitted task has finished, then rethrows the first
+	// exception a task let escape since the last wait, if any
+	void wait();
+private:
+	void work();
+};
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "meshlib.h"
+#include "../CubeReader/grid_array.hpp"
+#include "../Mesh/mesh_generator.hpp"
+#include "../Mesh/mesh_stats.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	// delivers the mesh in consecutive ranges, either to the callbacks or into the caller buffers
+	class OutputSink {
+	private:
+		meshlib_output& m_output;
+	public:
+		explicit OutputSink(meshlib_output& output) : m_output(output) {
+			m_output.vertex_count = 0;
+			m_output.face_count = 0;
+		}
+
+		meshlib_status put(const std::vector<Point>& vertices, const std::vector<IndexedTriangle>& faces) {
+			const bool callbacks = m_output.on_vertices && m_output.on_faces;
+
+			if (callbacks) {
+				if (!vertices.empty() && !m_output.on_vertices(m_output.user,
+					reinterpret_cast<const float*>(vertices.data()), vertices.size()))
+					return MESHLIB_CALLBACK_FAILED;
+				if (!faces.empty() && !m_output.on_faces(m_output.user,
+					reinterpret_cast<const int32_t*>(faces.data()), faces.size()))
+					return MESHLIB_CALLBACK_FAILED;
+			}
+			else {
+				copyInto(m_output.vertices, m_output.vertex_capacity, m_output.vertex_count, vertices);
+				copyInto(m_output.indices, m_output.face_capacity, m_output.face_count, faces);
+			}
+
+			m_output.vertex_count += vertices.size();
+			m_output.face_count += faces.size();
+			return MESHLIB_OK;
+		}
+
+		bool overflowed() const {
+			const bool callbacks = m_output.on_vertices && m_output.on_faces;
+			return !callbacks &&
+				(m_output.vertex_count > m_output.vertex_capacity || m_output.face_count > m_output.face_capacity);
+		}
+	private:
+		template <typename T, typename Item>
+		static void copyInto(T* buffer, std::size_t capacity, std::size_t used, const std::vector<Item>& items) {
+			if (!buffer || used >= capacity)
+				return;
+			const std::size_t count = std::min(items.size(), capacity - used);
+			std::memcpy(buffer + used * 3, items.data(), count * sizeof(Item));
+		}
+	};
+
+	GridArray volumeGrid(const meshlib_volume& volume) {
+		std::optional<Region> roi;
+		if (volume.use_roi)
+			roi = Region{ { volume.roi_min[0], volume.roi_min[1], volume.roi_min[2] },
+				{ volume.roi_max[0], volume.roi_max[1], volume.roi_max[2] } };
+
+		return { volume.occupancy, { volume.size[0], volume.size[1], volume.size[2] }, roi };
+	}
+
+	bool validVolume(const meshlib_volume* volume) {
+		return volume && volume->occupancy && volume->size[0] >= 2 && volume->size[1] >= 2 && volume->size[2] >= 2;
+	}
+}
+
+uint32_t meshlib_version(void) {
+	return MESHLIB_VERSION;
+}
+
+meshlib_status meshlib_mesh(const meshlib_volume* volume, meshlib_output* output) {
+	static_assert(sizeof(Point) == 3 * sizeof(float) && sizeof(IndexedTriangle) == 3 * sizeof(int32_t));
+	constexpr std::size_t chunkFaces = 1 << 14;
+
+	if (!validVolume(volume) || !output)
+		return MESHLIB_INVALID_ARGUMENT;
+
+	try {
+		const GridArray grid = volumeGrid(*volume);
+		const auto [cx, cy, cz] = grid.cubeCount();
+		const auto [ox, oy, oz] = grid.cubeOrigin();
+		const float yF = static_cast<float>(grid.fullCubeCount()[1]);
+
+		MeshGenerator mgen;
+		MeshBuilder mb;
+		OutputSink sink{ *output };
+		std::vector<Point> vertices;
+		std::vector<IndexedTriangle> faces;
+		const auto flush = [&]() {
+			mb.takePending(vertices, faces);
+			return sink.put(vertices, faces);
+		};
+
+		for (int64_t z = 0; z < cz; ++z) {
+			for (int64_t y = 0; y < cy; ++y) {
+				for (int64_t x = 0; x < cx; ++x) {
+					const Point offset{ 2.0f * (ox + x), 2.0f * (yF - oy - y - 1), 2.0f * (oz + z) };
+					for (const auto& tri : mgen.generateMesh(grid.cubeAt(x, y, z), offset))
+						mb.insertTriangle(tri);
+				}
+			}
+			if (mb.pendingFaceCount() >= chunkFaces)
+				if (const meshlib_status status = flush(); status != MESHLIB_OK)
+					return status;
+		}
+
+		if (const meshlib_status status = flush(); status != MESHLIB_OK)
+			return status;
+		return sink.overflowed() ? MESHLIB_BUFFER_TOO_SMALL : MESHLIB_OK;
+	}
+	catch (...) {
+		return MESHLIB_INTERNAL_ERROR;
+	}
+}
+
+meshlib_status meshlib_stats_of(const meshlib_volume* volume, meshlib_stats* stats) {
+	if (!validVolume(volume) || !stats)
+		return MESHLIB_INVALID_ARGUMENT;
+
+	try {
+		const GridArray grid = volumeGrid(*volume);
+		CubeHeader header;
+		header.count = grid.cubeCount();
+		header.origin = grid.cubeOrigin();
+		header.fullCount = grid.fullCubeCount();
+		header.scale = grid.scale();
+		const MeshStats result = computeStats(grid.allCubeCodes(), header);
+
+		*stats = { result.vertexCount, result.faceCount, result.area, result.volume,
+			{ result.min.x, result.min.y, result.min.z }, { result.max.x, result.max.y, result.max.z } };
+		return MESHLIB_OK;
+	}
+	catch (...) {
+		return MESHLIB_INTERNAL_ERROR;
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(MESHLIB_BUILD)
+#define MESHLIB_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define MESHLIB_API __declspec(dllimport)
+#else
+#define MESHLIB_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESHLIB_VERSION 1
+
+typedef enum meshlib_status {
+	MESHLIB_OK = 0,
+	MESHLIB_INVALID_ARGUMENT,
+	/* the caller buffers were filled; vertex_count and face_count hold the full sizes */
+	MESHLIB_BUFFER_TOO_SMALL,
+	MESHLIB_CALLBACK_FAILED,
+	MESHLIB_INTERNAL_ERROR,
+} meshlib_status;
+
+/* occupancy of a volume, read in place and never retained after the call */
+typedef struct meshlib_volume {
+	/* one byte per voxel, nonzero inside, x fastest, then y, then z */
+	const uint8_t* occupancy;
+	int64_t size[3];
+	/* when use_roi is set only the box [roi_min, roi_max) plus a one voxel halo is meshed */
+	int use_roi;
+	int64_t roi_min[3], roi_max[3];
+} meshlib_volume;
+
+/* callbacks return nonzero to continue; the pointers are only valid during the call */
+typedef int (*meshlib_vertex_callback)(void* user, const float* xyz, size_t vertex_count);
+typedef int (*meshlib_face_callback)(void* user, const int32_t* indices, size_t face_count);
+
+/* where the mesh goes: either callbacks, called with consecutive ranges while meshing,
+   or caller owned buffers of xyz triples and index triples */
+typedef struct meshlib_output {
+	float* vertices;
+	size_t vertex_capacity;
+	int32_t* indices;
+	size_t face_capacity;
+
+	meshlib_vertex_callback on_vertices;
+	meshlib_face_callback on_faces;
+	void* user;
+
+	/* set by meshlib_mesh */
+	size_t vertex_count;
+	size_t face_count;
+} meshlib_output;
+
+/* what meshlib_mesh would produce, computed from a histogram of cube codes without meshing */
+typedef struct meshlib_stats {
+	int64_t vertex_count;
+	int64_t face_count;
+	double area;
+	double volume;
+	float min[3], max[3];
+} meshlib_stats;
+
+MESHLIB_API uint32_t meshlib_version(void);
+
+/* meshes the volume in the frame of the PLY files written by Mesh: voxel (x, y, z)
+   lies at (2x, 2(size[1] - 1 - y), 2z), so that rows run downwards like image rows */
+MESHLIB_API meshlib_status meshlib_mesh(const meshlib_volume* volume, meshlib_output* output);
+MESHLIB_API meshlib_status meshlib_stats_of(const meshlib_volume* volume, meshlib_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif